@@ -0,0 +1,32 @@
+#version 460 core
+precision highp float;
+out vec4 FragColor;
+
+uniform sampler2D Input0;
+
+//one direction of the separable blur, (1,0) or (0,1)
+uniform vec2 direction;
+uniform float radius;
+
+layout (std140, binding = 0) uniform Frame {
+    mat4 projection;
+    vec4 outputSize;
+};
+
+void main(){
+    ivec2 center = ivec2(gl_FragCoord.xy);
+    ivec2 maxCoord = ivec2(outputSize.xy) - 1;
+    int samples = int(radius);
+    float sigma = max(radius / 2.0, 0.5);
+
+    vec4 sum = vec4(0.0);
+    float weightSum = 0.0;
+    for(int i = -samples; i <= samples; i++){
+        float weight = exp(-float(i * i) / (2.0 * sigma * sigma));
+        ivec2 coord = clamp(center + ivec2(direction) * i, ivec2(0), maxCoord);
+        sum += texelFetch(Input0, coord, 0) * weight;
+        weightSum += weight;
+    }
+
+    FragColor = sum / weightSum;
+}
@@ -0,0 +1,9 @@
+#version 460 core
+precision highp float;
+out vec4 FragColor;
+
+uniform sampler2D Input0;
+
+void main(){
+    FragColor = texelFetch(Input0, ivec2(gl_FragCoord.xy), 0);
+}
@@ -0,0 +1,17 @@
+#version 460 core
+precision highp float;
+out vec4 FragColor;
+
+uniform sampler2D Input0;
+uniform sampler2D Input1;
+
+//how much of the previous output is kept
+uniform float amount;
+
+void main(){
+    ivec2 coord = ivec2(gl_FragCoord.xy);
+    vec4 current = texelFetch(Input0, coord, 0);
+    vec4 previous = texelFetch(Input1, coord, 0);
+
+    FragColor = mix(current, previous, amount);
+}
@@ -0,0 +1,8 @@
+#version 460 core
+
+void main()
+{
+    //one triangle that covers the whole viewport, no vertex buffer needed
+    vec2 pos = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);
+    gl_Position = vec4(pos * 2.0 - 1.0, 0.0, 1.0);
+}
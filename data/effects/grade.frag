@@ -0,0 +1,20 @@
+#version 460 core
+precision highp float;
+out vec4 FragColor;
+
+uniform sampler2D Input0;
+
+uniform float brightness;
+uniform float contrast;
+uniform float saturation;
+
+void main(){
+    //all targets of a graph have the same used size, so the pixels line up
+    vec4 color = texelFetch(Input0, ivec2(gl_FragCoord.xy), 0);
+
+    vec3 graded = (color.rgb - 0.5) * contrast + 0.5 + brightness;
+    float luma = dot(graded, vec3(0.2126, 0.7152, 0.0722));
+    graded = mix(vec3(luma), graded, saturation);
+
+    FragColor = vec4(clamp(graded, 0.0, 1.0), color.a);
+}
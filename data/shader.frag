@@ -2,10 +2,70 @@
 precision highp float;
 out vec4 FragColor;
 
-in vec2 TexCoord;
+in vec3 TexCoord;
 
-uniform sampler2D Tex;
+//brightness, contrast and saturation of the tile, only used with TILE_GRADE
+flat in vec3 Grade;
+
+//The variant defines (PIXEL_FORMAT_*, COLOR_MATRIX_*, COLOR_RANGE_*, ALPHA_*, TILE_GRADE)
+//are inserted after the version line, see ShaderVariantKey.
+
+//the RGBA frame or the luma plane of a YUV frame
+uniform sampler2DArray Tex;
+
+#if defined(PIXEL_FORMAT_YUV420P)
+uniform sampler2DArray TexU;
+uniform sampler2DArray TexV;
+#elif defined(PIXEL_FORMAT_NV12)
+uniform sampler2DArray TexUV;
+#endif
+
+#if defined(PIXEL_FORMAT_YUV420P) || defined(PIXEL_FORMAT_NV12)
+vec3 yuvToRgb(vec3 yuv){
+#if defined(COLOR_RANGE_FULL)
+    yuv -= vec3(0.0, 0.5, 0.5);
+#else
+    yuv = (yuv - vec3(16.0, 128.0, 128.0) / 255.0) * vec3(255.0 / 219.0, 255.0 / 224.0, 255.0 / 224.0);
+#endif
+
+#if defined(COLOR_MATRIX_BT601)
+    const float kr = 0.299, kb = 0.114;
+#elif defined(COLOR_MATRIX_BT2020)
+    const float kr = 0.2627, kb = 0.0593;
+#else
+    const float kr = 0.2126, kb = 0.0722;
+#endif
+
+    float r = yuv.x + 2.0 * (1.0 - kr) * yuv.z;
+    float b = yuv.x + 2.0 * (1.0 - kb) * yuv.y;
+    float g = (yuv.x - kr * r - kb * b) / (1.0 - kr - kb);
+    return clamp(vec3(r, g, b), 0.0, 1.0);
+}
+#endif
 
 void main(){
-    FragColor = texture(Tex, TexCoord);
+#if defined(PIXEL_FORMAT_YUV420P)
+    vec3 yuv = vec3(texture(Tex, TexCoord).r, texture(TexU, TexCoord).r, texture(TexV, TexCoord).r);
+    vec4 color = vec4(yuvToRgb(yuv), 1.0);
+#elif defined(PIXEL_FORMAT_NV12)
+    vec3 yuv = vec3(texture(Tex, TexCoord).r, texture(TexUV, TexCoord).rg);
+    vec4 color = vec4(yuvToRgb(yuv), 1.0);
+#else
+    vec4 color = texture(Tex, TexCoord);
+#endif
+
+#if defined(TILE_GRADE)
+    //the same grade as the global effect, applied before the alpha is premultiplied
+    vec3 graded = (color.rgb - 0.5) * Grade.y + 0.5 + Grade.x;
+    float luma = dot(graded, vec3(0.2126, 0.7152, 0.0722));
+    color.rgb = clamp(mix(vec3(luma), graded, Grade.z), 0.0, 1.0);
+#endif
+
+#if defined(ALPHA_OPAQUE)
+    color.a = 1.0;
+#elif defined(ALPHA_STRAIGHT)
+    color.rgb *= color.a;
+#endif
+
+    FragColor = color;
 }
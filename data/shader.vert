@@ -1,13 +1,22 @@
 #version 460 core
 layout (location = 0) in vec2 aPos;
-layout (location = 1) in vec2 aTexCoord;
+layout (location = 1) in vec4 aRect;
+layout (location = 2) in vec4 aTexArea;
+layout (location = 3) in float aLayer;
+layout (location = 4) in vec3 aGrade;
 
-out vec2 TexCoord;
+out vec3 TexCoord;
+flat out vec3 Grade;
 
-uniform mat4 transform;
+layout (std140, binding = 0) uniform Frame {
+    mat4 projection;
+    vec4 outputSize;
+};
 
 void main()
 {
-    gl_Position = transform*vec4(aPos, 0.0 , 1.0);
-    TexCoord = aTexCoord;
+    //move the unit quad into the tile rectangle and map it to the used part of the layer
+    gl_Position = projection*vec4(aRect.xy + aPos*aRect.zw, 0.0 , 1.0);
+    TexCoord = vec3(mix(aTexArea.xy, aTexArea.zw, aPos), aLayer);
+    Grade = aGrade;
 }
@@ -0,0 +1,38 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace sakurajin{
+    //Counts the heap allocations of the whole process while it is enabled, to find
+    //allocations in the steady state of playback. The counting comes from replacing
+    //malloc and friends, which is only compiled in with the allocation_counter build
+    //option. Without it the counter is never available and counts nothing.
+    class AllocationCounter{
+    public:
+        struct Count{
+            uint64_t allocations = 0;
+            uint64_t bytes = 0;
+        };
+
+        //allocations of the current thread are not counted while a pause exists,
+        //for code that is known to allocate and can't be changed
+        class Pause{
+        public:
+            Pause();
+            ~Pause();
+
+            Pause(const Pause&) = delete;
+            Pause& operator=(const Pause&) = delete;
+        };
+
+        //true if the binary was built with the allocation_counter option
+        static bool isAvailable();
+
+        //reset the count and start counting
+        static void start();
+
+        //stop counting and get the allocations since start()
+        static Count stop();
+    };
+}
@@ -0,0 +1,93 @@
+#pragma once
+
+#include <atomic>
+#include <future>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "media_resources.hpp"
+#include "video_tile.hpp"
+#include "worker_pool.hpp"
+
+namespace sakurajin{
+    class ClipOpener;
+
+    //The handle of a tile that is opened in the background by a ClipOpener.
+    //It is polled by the thread that shows the tiles, the slot shows a placeholder
+    //until the tile is ready and can be taken. A file that is opened with all of its
+    //streams gives one tile per video stream. The opener has to outlive the handle.
+    class PendingTile{
+        friend class ClipOpener;
+    public:
+        enum class State{
+            opening,
+            ready,
+            failed,
+            cancelled
+        };
+    private:
+        std::string filename;
+        ClipOpener* opener = nullptr;
+        std::shared_ptr<std::atomic<bool>> cancelled;
+        std::future<std::vector<std::unique_ptr<VideoTile>>> result;
+        std::vector<std::unique_ptr<VideoTile>> tiles;
+        State state = State::opening;
+        std::string error;
+
+        void collect();
+    public:
+        PendingTile(const std::string& filename);
+
+        PendingTile(const PendingTile&) = delete;
+        PendingTile& operator=(const PendingTile&) = delete;
+
+        const std::string& getFilename() const;
+        const std::string& getError() const;
+
+        //check if the open finished without blocking
+        State poll();
+
+        //block until the open finished
+        State wait();
+
+        //stop the open, a reader that is probing or decoding stops at its next read.
+        //A tile that is already open but wasn't taken is closed by the opener.
+        void cancel();
+
+        //get the opened tile of the first stream, its first frame is already decoded.
+        //The tiles of the other streams are closed.
+        //Returns nullptr if the tile isn't ready or was taken already.
+        std::unique_ptr<VideoTile> take();
+
+        //get the tiles of every opened stream, empty if they aren't ready or were taken already
+        std::vector<std::unique_ptr<VideoTile>> takeAll();
+    };
+
+    //Opens tiles on worker threads, so probing the file and setting up the decoder
+    //never blocks the render loop. Every open can be cancelled through its handle.
+    //Tiles that are replaced are closed on another thread as well.
+    class ClipOpener{
+    private:
+        MediaResources resources;
+        std::unique_ptr<WorkerPool> pool;
+        //closing only waits for the decoder threads, it doesn't queue behind the opens
+        std::unique_ptr<WorkerPool> closePool;
+
+        //the opens that may still run, they are cancelled when the opener is destroyed
+        std::vector<std::weak_ptr<std::atomic<bool>>> running;
+    public:
+        ClipOpener(const MediaResources& resources, unsigned int threadCount = 2);
+        ~ClipOpener();
+
+        ClipOpener(const ClipOpener&) = delete;
+        ClipOpener& operator=(const ClipOpener&) = delete;
+
+        //start opening a tile and decode its first frame. With all streams every video
+        //stream of the file gets a tile, they share one demuxer and only play forward.
+        std::shared_ptr<PendingTile> open(const std::string& filename, bool reverse, bool allStreams = false);
+
+        //destroy a tile that isn't shown anymore in the background
+        void close(std::unique_ptr<VideoTile> tile);
+    };
+}
@@ -0,0 +1,109 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "worker_pool.hpp"
+
+namespace sakurajin{
+    //The content of one clip file loaded into memory by a ClipPreloader.
+    //The readers demux straight from the data once it is ready.
+    class PreloadedClip{
+        friend class ClipPreloader;
+    public:
+        enum class State{
+            loading,
+            ready,
+            failed
+        };
+    private:
+        std::string filename;
+        size_t size;
+        std::unique_ptr<uint8_t[]> data;
+
+        std::atomic<size_t> loadedBytes{0};
+        std::atomic<bool> cancelled{false};
+
+        mutable std::mutex stateMutex;
+        mutable std::condition_variable stateChanged;
+        State state = State::loading;
+
+        void setState(State state);
+    public:
+        PreloadedClip(const std::string& filename, size_t size);
+
+        PreloadedClip(const PreloadedClip&) = delete;
+        PreloadedClip& operator=(const PreloadedClip&) = delete;
+
+        const std::string& getFilename() const;
+        size_t getSize() const;
+        State getState() const;
+
+        //the bytes that were read so far, this is also the resident size of the clip
+        size_t getLoadedBytes() const;
+        float getProgress() const;
+
+        //block until the clip is loaded, returns false if loading failed or was cancelled
+        bool wait() const;
+
+        //block until the clip isn't loading anymore or the timeout passed,
+        //returns false on the timeout, the state tells if loading worked then
+        bool waitFor(std::chrono::milliseconds timeout) const;
+
+        //the whole file, only valid once the clip is ready
+        const uint8_t* getData() const;
+    };
+
+    //Loads short clips completely into memory in the background, so playing them
+    //never touches the disk. Clips above the size limit are not preloaded. The loaded
+    //clips share a memory budget, clips that no reader uses anymore are dropped
+    //(oldest first) to make room for new ones.
+    class ClipPreloader{
+    public:
+        struct Config{
+            size_t maxClipSize = 256 * 1024 * 1024;
+            size_t memoryBudget = 2048ull * 1024 * 1024;
+            unsigned int threads = 2;
+        };
+    private:
+        Config config;
+
+        //ordered by the last request, the most recent is at the back
+        mutable std::mutex clipMutex;
+        std::vector<std::shared_ptr<PreloadedClip>> clips;
+        size_t reservedBytes = 0;
+
+        std::unique_ptr<WorkerPool> pool;
+
+        static void load(PreloadedClip& clip);
+        bool makeRoom(size_t size);
+    public:
+        ClipPreloader();
+        explicit ClipPreloader(const Config& config);
+        ~ClipPreloader();
+
+        ClipPreloader(const ClipPreloader&) = delete;
+        ClipPreloader& operator=(const ClipPreloader&) = delete;
+
+        //start loading a clip or get the one that is already loaded or loading.
+        //Returns nullptr if the file is too large, can't be opened or doesn't fit the budget.
+        std::shared_ptr<PreloadedClip> preload(const std::string& filename);
+
+        //drop a clip if no reader uses it, a running load is cancelled
+        void release(const std::string& filename);
+
+        //all clips that are loaded or loading
+        std::vector<std::shared_ptr<PreloadedClip>> getClips() const;
+
+        //the memory reserved for all clips, the loaded part of it is resident
+        size_t getReservedBytes() const;
+        const Config& getConfig() const;
+    };
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "clip_opener.hpp"
+#include "media_resources.hpp"
+#include "video_tile.hpp"
+
+namespace sakurajin{
+    //Plays an ordered list of cues and warms up the next ones in the background:
+    //the clip is preloaded, its reader opened (with the keyframe index for reverse
+    //cues) and the first frame decoded, so firing a warm cue only has to upload one
+    //frame. Only the cues inside the lookahead are warmed, on a fixed number of
+    //threads, and the preloader budget limits their memory. Skipped cues are
+    //cancelled and their tiles and preloaded data are released. Firing never waits,
+    //a late cue is handed over while it is still warming up.
+    class CuePrefetcher{
+    public:
+        struct Cue{
+            std::string filename;
+            bool reverse = false;
+        };
+
+        enum class CueState{
+            cold,
+            warming,
+            warm,
+            failed,
+            played,
+            skipped
+        };
+
+        struct Config{
+            //how many of the upcoming cues are kept warm
+            size_t lookahead = 2;
+            //the decode threads the warming may use
+            unsigned int threads = 1;
+        };
+    private:
+        //the tile of a warm cue stays in its pending handle until the cue is fired
+        struct Slot{
+            Cue cue;
+            CueState state = CueState::cold;
+            std::shared_ptr<PendingTile> pending;
+        };
+
+        MediaResources resources;
+        Config config;
+        std::vector<Slot> cues;
+        size_t nextCue = 0;
+
+        //opens the cues and closes the skipped ones
+        std::unique_ptr<ClipOpener> opener;
+
+        void collect(Slot& slot);
+        void cancel(Slot& slot, CueState state);
+        void schedule();
+    public:
+        CuePrefetcher(const MediaResources& resources, std::vector<Cue> cues);
+        CuePrefetcher(const MediaResources& resources, std::vector<Cue> cues, const Config& config);
+        ~CuePrefetcher();
+
+        CuePrefetcher(const CuePrefetcher&) = delete;
+        CuePrefetcher& operator=(const CuePrefetcher&) = delete;
+
+        //read a cue list, one file per line. Empty lines and lines starting with # are ignored.
+        static std::vector<Cue> loadCueList(const std::string& filename, bool reverse);
+
+        //pick up the finished warm ups, call this once per frame
+        void update();
+
+        //take the handle of the next cue without waiting. The tile of a warm cue is ready
+        //right away, a cue that is still warming up is ready later, so the current tile
+        //can stay on screen until then. Cues that already failed are passed over.
+        //Returns nullptr once every cue was played.
+        std::shared_ptr<PendingTile> fire();
+
+        //skip the next cue without playing it
+        void skip();
+
+        size_t getCueCount() const;
+        size_t getNextCue() const;
+        const Cue& getCue(size_t cue) const;
+        CueState getCueState(size_t cue) const;
+        static const char* getStateName(CueState state);
+    };
+}
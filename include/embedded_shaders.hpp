@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstddef>
+#include <filesystem>
+#include <optional>
+#include <string_view>
+
+namespace sakurajin{
+    //The default shaders are compiled into the binary by scripts/embed_shaders.py.
+    //With the shader_override build option the files in the working directory are
+    //used instead if they exist, so they can be edited without rebuilding. Without
+    //it (the default for release builds) shaders are never read from disk.
+    class EmbeddedShaders{
+    public:
+        struct File{
+            std::string_view location;
+            std::string_view content;
+        };
+    private:
+        //defined in the generated embedded_shader_data.cpp
+        static const File files[];
+        static const size_t fileCount;
+    public:
+        //the embedded content for a path relative to the source directory, e.g. data/shader.vert
+        static std::optional<std::string_view> find(const std::filesystem::path& location);
+
+        //true if files on disk take precedence over the embedded ones
+        static bool allowsOverride();
+
+        //true if the file can be loaded, either from disk or embedded
+        static bool exists(const std::filesystem::path& location);
+    };
+}
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <stdexcept>
+#include <vector>
+
+namespace sakurajin{
+    //a frame buffer from a FrameMemoryPool, it goes back to the pool once the last copy is released
+    using FrameMemory = std::shared_ptr<uint8_t>;
+
+    //Recycles the CPU side frame buffers of all tiles and decoders.
+    //Requests are rounded up to size classes, four per power of two, so frames of
+    //slightly different sizes share buffers and a resolution change only allocates
+    //once per new class. Released buffers are kept on a free list per class until
+    //the cache limit is reached. Large buffers can be backed by huge pages.
+    //The pool can be used from any thread, buffers may outlive the pool.
+    class FrameMemoryPool{
+    public:
+        enum class HugePages{
+            //plain aligned heap allocations
+            none,
+            //mmap and ask for transparent huge pages with madvise
+            transparent,
+            //use the reserved huge pages (MAP_HUGETLB), transparent if none are left
+            reserved
+        };
+
+        //the cache line, AVX-512 registers and sws both want 64 bytes, 4096 aligns to pages
+        static constexpr size_t defaultAlignment = 64;
+        static constexpr size_t hugePageSize = 2 * 1024 * 1024;
+
+        struct Config{
+            size_t alignment = defaultAlignment;
+            HugePages hugePages = HugePages::transparent;
+            //released buffers above this are returned to the system right away
+            size_t maxCachedBytes = 512 * 1024 * 1024;
+        };
+
+        struct Stats{
+            uint64_t acquires = 0;
+            uint64_t reuses = 0;
+            uint64_t systemAllocations = 0;
+            uint64_t systemFrees = 0;
+            size_t bytesInUse = 0;
+            size_t peakBytesInUse = 0;
+            size_t bytesCached = 0;
+            //the mapped bytes that were given to or advised for huge pages
+            size_t hugePageBytes = 0;
+            //the reference count blocks of the handed out buffers that weren't reused
+            uint64_t handleAllocations = 0;
+        };
+    private:
+        struct Allocation{
+            void* data;
+            size_t size;
+            bool mapped;
+            //counted in the huge page stats, set if the mapping got or was advised for huge pages
+            bool hugePages;
+        };
+
+        //the largest shared_ptr control block of a buffer, checked when the allocator is rebound
+        static constexpr size_t handleSize = 128;
+
+        //the buffers keep the state alive, so it is shared with their handles
+        struct State{
+            Config config;
+            std::mutex mutex;
+            std::map<size_t, std::vector<Allocation>> freeLists;
+            //released control blocks, reused so handing out a buffer doesn't allocate
+            std::vector<void*> freeHandles;
+            Stats stats;
+
+            ~State();
+            //called without holding the mutex, so it doesn't touch the stats
+            Allocation allocate(size_t size);
+            void free(const Allocation& allocation);
+            void release(Allocation allocation);
+
+            void* acquireHandle();
+            void releaseHandle(void* handle);
+        };
+
+        //Allocates the control blocks of the buffers from the free list of the state.
+        //The control block keeps a copy of the allocator, which keeps the state alive
+        //until the block itself is given back.
+        template<typename T>
+        struct HandleAllocator{
+            using value_type = T;
+            std::shared_ptr<State> state;
+
+            explicit HandleAllocator(std::shared_ptr<State> _state) : state{std::move(_state)} {}
+            template<typename U>
+            HandleAllocator(const HandleAllocator<U>& other) : state{other.state} {}
+
+            T* allocate(size_t count){
+                static_assert(sizeof(T) <= handleSize && alignof(T) <= alignof(std::max_align_t), "the control block doesn't fit into a handle");
+                if(count != 1){
+                    throw std::bad_alloc();
+                }
+                return static_cast<T*>(state->acquireHandle());
+            }
+
+            void deallocate(T* handle, size_t){
+                state->releaseHandle(handle);
+            }
+
+            template<typename U>
+            bool operator==(const HandleAllocator<U>& other) const{
+                return state == other.state;
+            }
+            template<typename U>
+            bool operator!=(const HandleAllocator<U>& other) const{
+                return state != other.state;
+            }
+        };
+
+        std::shared_ptr<State> state;
+    public:
+        FrameMemoryPool();
+        explicit FrameMemoryPool(const Config& config);
+
+        FrameMemoryPool(const FrameMemoryPool&) = delete;
+        FrameMemoryPool& operator=(const FrameMemoryPool&) = delete;
+
+        //the usable size of the buffer a request of the given size gets
+        size_t getSizeClass(size_t size) const;
+
+        //get a buffer of at least the given size, the content is undefined
+        FrameMemory acquire(size_t size);
+
+        //return every cached buffer to the system
+        void trim();
+
+        const Config& getConfig() const;
+        Stats getStats() const;
+    };
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include <cstdint>
+
+#include "shader_variants.hpp"
+
+namespace sakurajin{
+    //The planes of one decoded frame as they are uploaded to the grid renderer.
+    //RGBA frames use only the first plane, YUV420P uses three and NV12 two.
+    //The view does not own the data, it is valid until the tile shows the next frame.
+    struct FrameView{
+        PixelFormat format = PixelFormat::rgba;
+        const uint8_t* planes[3] = {nullptr, nullptr, nullptr};
+        int linesizes[3] = {0, 0, 0};
+        int width = 0;
+        int height = 0;
+
+        bool isValid() const{
+            return planes[0] != nullptr && width > 0 && height > 0;
+        }
+    };
+}
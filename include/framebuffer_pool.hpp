@@ -0,0 +1,79 @@
+#pragma once
+
+#include <memory>
+#include <stdexcept>
+#include <vector>
+
+#include "imguiHandler.hpp"
+
+namespace sakurajin{
+    //a render target with one color texture, it is owned by a FramebufferPool.
+    //The texture can be larger than the used area to avoid reallocations on resize.
+    class Framebuffer{
+    private:
+        unsigned int FBO = 0;
+        unsigned int texture = 0;
+        int width = 0;
+        int height = 0;
+        GLenum format = GL_RGBA8;
+
+        int usedWidth = 0;
+        int usedHeight = 0;
+
+        //frames in a row where the used area was much smaller than the texture
+        int oversizedFrames = 0;
+        uint64_t lastUsedFrame = 0;
+
+        friend class FramebufferPool;
+    public:
+        Framebuffer(int width, int height, GLenum format);
+        ~Framebuffer();
+
+        Framebuffer(const Framebuffer&) = delete;
+        Framebuffer& operator=(const Framebuffer&) = delete;
+
+        //bind the framebuffer and set the viewport to the used area
+        void bind();
+        void clear(float r, float g, float b, float a);
+
+        unsigned int getTexture() const;
+        int getWidth() const;
+        int getHeight() const;
+        GLenum getFormat() const;
+        int getUsedWidth() const;
+        int getUsedHeight() const;
+        size_t getByteSize() const;
+
+        //the texture coordinates of the used area, for displaying it with ImGui
+        ImVec2 getUsedUV() const;
+    };
+
+    //Hands out render targets keyed by size and format. Targets are reused while they are
+    //not referenced anymore and only freed after they were unused for a while, so passes
+    //and windows that come and go don't reallocate every frame.
+    class FramebufferPool{
+    private:
+        std::vector<std::shared_ptr<Framebuffer>> framebuffers;
+        uint64_t currentFrame = 0;
+
+        static int roundSize(int size);
+    public:
+        FramebufferPool() = default;
+
+        FramebufferPool(const FramebufferPool&) = delete;
+        FramebufferPool& operator=(const FramebufferPool&) = delete;
+
+        //get an unused target that can hold the size, a new one is created if none fits
+        std::shared_ptr<Framebuffer> acquire(int width, int height, GLenum format = GL_RGBA8);
+
+        //keep the target if it still fits and is not oversized for too long,
+        //otherwise replace it by a fitting one from the pool
+        void resize(std::shared_ptr<Framebuffer>& target, int width, int height, GLenum format = GL_RGBA8);
+
+        //call once per frame, frees the targets that were unused for too long
+        void endFrame();
+
+        size_t getTargetCount() const;
+        size_t getAllocatedBytes() const;
+    };
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <atomic>
+#include <deque>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "media_resources.hpp"
+#include "video_reader.hpp"
+#include "worker_pool.hpp"
+
+namespace sakurajin{
+    //Decodes independent GOPs in parallel, each worker uses its own decoder instance.
+    //The GOP boundaries come from the keyframe index, the frames are handed out in
+    //presentation order (or reversed presentation order for reverse playback).
+    //This is meant for offline rendering and reverse playback, realtime playback
+    //should keep using video_reader_read_frame().
+    //Every GOP is held as RGBA frames until it was played, so the GOPs in flight are
+    //limited by their estimated size in bytes and not only by their number.
+    class GopDecoder{
+    public:
+        enum class Direction{
+            forward,
+            reverse
+        };
+    private:
+        struct DecodedFrame{
+            int64_t pts;
+            FrameMemory data;
+        };
+        using DecodedGop = std::vector<DecodedFrame>;
+
+        struct PendingGop{
+            std::future<DecodedGop> frames;
+            size_t estimatedBytes;
+            double seconds;
+        };
+
+        std::string filename;
+        Direction direction;
+        MediaResources resources;
+        std::shared_ptr<PreloadedClip> preloadedClip;
+
+        //every reader is one decoder instance, the idle ones can be taken by a job
+        std::mutex readerMutex;
+        std::vector<std::unique_ptr<VideoReaderState>> readers;
+        std::vector<VideoReaderState*> idleReaders;
+
+        //the keyframe index is copied out of the first reader since the readers are shared
+        std::vector<int64_t> keyframes;
+        int width = 0, height = 0;
+        AVRational time_base{0, 1};
+
+        //the decoded GOPs in playback order, the front is handed out next
+        std::deque<PendingGop> pendingGops;
+        size_t nextSubmitPosition = 0;
+        size_t maxGopsInFlight = 0;
+
+        //the estimated bytes of the pending GOPs and the actual bytes of the current one.
+        //The estimate uses the largest data rate of the GOPs decoded so far, until the
+        //first GOP is done only one is decoded at a time.
+        size_t memoryBudget;
+        size_t bytesInFlight = 0;
+        double bytesPerSecond = 0.0;
+
+        DecodedGop currentGop;
+        size_t currentGopBytes = 0;
+        size_t currentFrame = 0;
+
+        std::atomic<bool> cancelled{false};
+        std::atomic<bool> referenceOnly{false};
+        std::unique_ptr<WorkerPool> pool;
+
+        VideoReaderState* acquireReader();
+        void releaseReader(VideoReaderState* reader);
+
+        size_t gopAtPosition(size_t position) const;
+        double getGopSeconds(size_t gop) const;
+        DecodedGop decodeGop(size_t gop);
+        void submitGops();
+    public:
+        //the decoded GOPs may take this many bytes, a single larger GOP is still decoded
+        static constexpr size_t defaultMemoryBudget = 1024ull * 1024 * 1024;
+
+        //a thread count of 0 uses one decoder per hardware thread
+        GopDecoder(const std::string& filename, const MediaResources& resources, Direction direction = Direction::forward, unsigned int threadCount = 0, size_t memoryBudget = defaultMemoryBudget);
+        ~GopDecoder();
+
+        GopDecoder(const GopDecoder&) = delete;
+        GopDecoder& operator=(const GopDecoder&) = delete;
+
+        int getWidth() const;
+        int getHeight() const;
+        AVRational getTimeBase() const;
+        size_t getGopCount() const;
+
+        //only decode the reference frames of the GOPs that start decoding from now on
+        void setReferenceOnly(bool referenceOnly);
+
+        //get the next frame in playback order as RGBA data with the size of the video,
+        //the caller shares the buffer, returns false once every GOP was played
+        bool nextFrame(FrameMemory& frame_data, int64_t& pts);
+    };
+}
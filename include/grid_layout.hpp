@@ -0,0 +1,30 @@
+#pragma once
+
+#include <cstddef>
+
+namespace sakurajin{
+    //rectangle of a tile inside the output in pixels, the origin is the top left corner
+    struct TileRect{
+        float x = 0.0f;
+        float y = 0.0f;
+        float width = 0.0f;
+        float height = 0.0f;
+    };
+
+    class GridLayout{
+    private:
+        unsigned int columns = 1;
+        unsigned int rows = 1;
+    public:
+        //create the most square grid that fits all tiles
+        GridLayout(size_t tileCount);
+        GridLayout(unsigned int columns, unsigned int rows);
+
+        unsigned int getColumns() const;
+        unsigned int getRows() const;
+        size_t getTileCount() const;
+
+        //get the area of a tile, the video is fit into its cell keeping the aspect ratio
+        TileRect getTileRect(size_t index, float outputWidth, float outputHeight, float aspectRatio) const;
+    };
+}
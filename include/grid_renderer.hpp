@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "shader_variants.hpp"
+#include "frame_view.hpp"
+#include "grid_layout.hpp"
+
+namespace sakurajin{
+    //the colour grade of a single tile, it is applied by the tile shader while the grid is drawn,
+    //so it needs no pass and no render target of its own
+    struct TileGrade{
+        bool enabled = false;
+        float brightness = 0.0f;
+        float contrast = 1.0f;
+        float saturation = 1.0f;
+    };
+
+    //Draws every tile of the grid with one instanced draw call per shader variant and
+    //resolution class. The frames of all tiles are stored in the layers of texture arrays,
+    //one per plane type so YUV frames are uploaded plane by plane without conversion.
+    //Frames of a similar size share a resolution class with its own arrays, so a small
+    //tile doesn't take a layer as large as the largest frame. The position, texture area
+    //and layer of each tile are stored in a per-instance buffer that is only updated when
+    //the layout changes. The instances are sorted by variant and class, so every draw call
+    //is one contiguous range of the buffer. A tile can show the layers of another tile,
+    //so a frame that is shown several times is only uploaded once. The per-tile effects
+    //are part of the instance data as well, the variant decides if they are applied.
+    class GridRenderer{
+    private:
+        //has to match the per-instance attributes in shader.vert
+        struct TileInstance{
+            float rect[4];
+            float uv[4];
+            float layer;
+            float grade[3];
+        };
+
+        static constexpr size_t noLayerClass = SIZE_MAX;
+
+        struct TileState{
+            TileRect rect;
+            bool visible = false;
+            int frameWidth = 0;
+            int frameHeight = 0;
+            PixelFormat format = PixelFormat::rgba;
+            uint32_t variant = 0;
+            TileGrade grade;
+            //the tile whose layers are shown, this is the tile itself unless it shares them
+            size_t source = 0;
+            //the resolution class and the layer in its arrays that hold the frame
+            size_t layerClass = noLayerClass;
+            int layer = 0;
+        };
+
+        //the arrays are only allocated once a frame with that plane is uploaded
+        enum Plane{
+            rgbaPlane,
+            lumaPlane,
+            chromaUPlane,
+            chromaVPlane,
+            chromaUVPlane,
+            planeCount
+        };
+
+        struct LayerArray{
+            unsigned int texture = 0;
+            unsigned int internalFormat = 0;
+            unsigned int pixelFormat = 0;
+            int bytesPerPixel = 0;
+            int width = 0;
+            int height = 0;
+            int layers = 0;
+        };
+
+        //the arrays of all frames that fit the same layer size, every allocated array
+        //of a class has the same number of layers. The size of an unused class is 0.
+        struct LayerClass{
+            int width = 0;
+            int height = 0;
+            LayerArray arrays[planeCount];
+            std::vector<bool> usedLayers;
+        };
+
+        //the instances of one shader variant in one resolution class
+        struct InstanceGroup{
+            uint32_t variant;
+            size_t layerClass;
+            size_t first;
+            size_t count;
+        };
+
+        unsigned int VAO = 0, VBO = 0, EBO = 0, instanceVBO = 0;
+        //the formats of the plane arrays, every new class starts with a copy
+        LayerArray planeFormats[planeCount];
+        std::vector<LayerClass> layerClasses;
+
+        std::vector<TileState> tiles;
+        size_t instanceCount = 0;
+        std::vector<InstanceGroup> instanceGroups;
+        size_t instanceCapacity = 0;
+        bool instancesDirty = true;
+
+        static int getClassSize(int size);
+        void allocateTextureArray(LayerArray& array, int width, int height, int layers);
+        bool reserveArray(LayerClass& layerClass, Plane plane);
+        bool acquireLayer(TileState& state, int width, int height);
+        void releaseLayer(TileState& state);
+        void uploadPlane(const LayerArray& array, int layer, const uint8_t* data, int linesize, int width, int height);
+        void updateInstances();
+    public:
+        GridRenderer();
+        ~GridRenderer();
+
+        GridRenderer(const GridRenderer&) = delete;
+        GridRenderer& operator=(const GridRenderer&) = delete;
+
+        void setTileCount(size_t count);
+        size_t getTileCount() const;
+
+        //update where a tile is drawn, the instance data only changes if this is different.
+        //Returns true if the tile moved or was shown or hidden.
+        bool setTileRect(size_t tile, const TileRect& rect, bool visible);
+
+        //set the packed shader variant key a tile is drawn with
+        void setTileVariant(size_t tile, uint32_t variant);
+
+        //set the grade of a tile, it is only applied by variants with the grade enabled.
+        //Returns true if the grade changed.
+        bool setTileGrade(size_t tile, const TileGrade& grade);
+
+        //draw a tile with the layers and frame size of another tile instead of its own,
+        //passing the tile itself goes back to its own layers
+        void setTileSource(size_t tile, size_t source);
+
+        //move the tile into the resolution class of the frame and make sure the class has
+        //the arrays the frame needs. Growing the arrays of a class discards all of their
+        //layers. Returns true if the tiles have to be uploaded again.
+        bool reserveLayers(size_t tile, const FrameView& frame);
+
+        //upload the planes of a tile into its layers, the rows are read with the
+        //linesize of the frame so the decoder output is used as it is
+        void uploadTile(size_t tile, const FrameView& frame);
+
+        //draw all visible tiles into the currently bound framebuffer,
+        //the projection comes from the bound Frame uniform block.
+        //Returns false if a variant was skipped because its program isn't built yet.
+        bool draw(ShaderVariants& variants);
+
+        //the largest layer size of the RGBA and luma arrays
+        int getLayerWidth() const;
+        int getLayerHeight() const;
+        size_t getLayerClassCount() const;
+        size_t getVisibleTileCount() const;
+        size_t getDrawCallCount() const;
+    };
+}
@@ -43,9 +43,9 @@ namespace sakurajin{
         void init_impl();
         void startRender_impl();
         void endRender_impl();
-        void initFramebuffer_impl(unsigned int& FBO, unsigned int& texture, uint64_t width = 3840, uint64_t height = 2160);
-        void loadFramebuffer_impl ( unsigned int buf, uint64_t width = 3840, uint64_t height = 2160 );
         void updateRenderThread_impl();
+        bool isMinimized_impl();
+        int getRefreshRate_impl();
         
         public:
         static void init(){
@@ -60,16 +60,18 @@ namespace sakurajin{
             getInstance().endRender_impl();
         }
         
-        static void initFramebuffer(unsigned int& FBO, unsigned int& texture, uint64_t width = 3840, uint64_t height = 2160){
-            getInstance().initFramebuffer_impl(FBO,texture,width,height);
+        static void updateRenderThread(){
+            getInstance().updateRenderThread_impl();
         }
         
-        static void loadFramebuffer ( unsigned int buf, uint64_t width = 3840, uint64_t height = 2160 ){
-            getInstance().loadFramebuffer_impl(buf, width, height);
+        //true if the main window is minimized or hidden and nothing can be seen
+        static bool isMinimized(){
+            return getInstance().isMinimized_impl();
         }
         
-        static void updateRenderThread(){
-            getInstance().updateRenderThread_impl();
+        //the refresh rate of the display the window is on, 60 if it is unknown
+        static int getRefreshRate(){
+            return getInstance().getRefreshRate_impl();
         }
         
     };
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace sakurajin{
+    //Compares the inputs of the readers: the default file protocol, mapped files and
+    //reads through the IoScheduler.
+    //Every reader demuxes one clip to the end without decoding, all readers run at
+    //the same time like the tiles of a large grid do.
+    class IoBenchmark{
+    public:
+        enum class Input{
+            fileProtocol,
+            memoryMapped,
+            scheduled
+        };
+
+        struct Result{
+            size_t readers = 0;
+            //readers that use the requested input, the others fell back to the file protocol
+            size_t customInputReaders = 0;
+            //the peak queue depth and stalls of the scheduled input
+            unsigned int peakQueueDepth = 0;
+            uint64_t stalls = 0;
+            uint64_t packets = 0;
+            uint64_t bytes = 0;
+            double seconds = 0.0;
+        };
+
+        //the clips are repeated until there are readerCount readers,
+        //the page cache is not dropped, so the first run may include disk reads
+        static Result run(const std::vector<std::string>& files, size_t readerCount, Input input);
+
+        //run both variants and print the comparison
+        static bool runComparison(const std::vector<std::string>& files, size_t readerCount);
+    };
+}
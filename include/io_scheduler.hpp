@@ -0,0 +1,139 @@
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "worker_pool.hpp"
+
+#if defined(SAKURAJIN_IO_URING) && SAKURAJIN_IO_URING
+#include <liburing.h>
+#endif
+
+namespace sakurajin{
+    class IoScheduler;
+
+    //One file read through an IoScheduler. The reads of the demuxer are served from
+    //blocks that were read ahead of it, so it only waits if the window runs dry.
+    //A stream is used by one reader thread at a time.
+    class IoStream{
+        friend class IoScheduler;
+    private:
+        struct File;
+        struct Block;
+
+        IoScheduler& scheduler;
+        std::shared_ptr<File> file;
+        int64_t fileSize = 0;
+        int64_t position = 0;
+        size_t readahead = 0;
+
+        //true while the reader waits for a block, those reads go first
+        bool waiting = false;
+        std::map<int64_t, std::shared_ptr<Block>> blocks;
+
+        IoStream(IoScheduler& scheduler, std::shared_ptr<File> file, int64_t fileSize);
+    public:
+        IoStream(const IoStream&) = delete;
+        IoStream& operator=(const IoStream&) = delete;
+
+        //AVIOContext callbacks, they return FFmpeg error codes
+        int read(uint8_t* buffer, int size);
+        int64_t seek(int64_t offset, int whence);
+
+        //size the readahead window for the bitrate of the file in bits per second
+        void setBitrate(int64_t bitrate);
+
+        int64_t getFileSize() const;
+    };
+
+    //Reads the files of many streams at once with large aligned reads. The reads go
+    //through one shared io_uring instance, or through a small thread pool with pread
+    //if the build has no liburing or the kernel refuses to set up a ring.
+    //Every stream has a readahead window sized by its bitrate. When there are more
+    //reads than the queue depth, the streams with the least data ahead of their
+    //reader go first, so the stream closest to running dry gets served first.
+    class IoScheduler{
+        friend class IoStream;
+    public:
+        struct Config{
+            unsigned int queueDepth = 64;
+            //has to be a multiple of 4096 for direct IO
+            size_t blockSize = 1024 * 1024;
+            double readaheadSeconds = 2.0;
+            size_t maxReadahead = 64 * 1024 * 1024;
+            //bypass the page cache with O_DIRECT, files that don't support it are read normally
+            bool directIo = false;
+            unsigned int fallbackThreads = 8;
+        };
+
+        struct Stats{
+            bool ioUring = false;
+            size_t streams = 0;
+            uint64_t reads = 0;
+            uint64_t bytesRead = 0;
+            //reads of the demuxer that had to wait for their block
+            uint64_t stalls = 0;
+            unsigned int queueDepth = 0;
+            unsigned int peakQueueDepth = 0;
+            //bytes per second since the previous call of getStats()
+            double throughput = 0.0;
+        };
+    private:
+        Config config;
+
+        std::mutex mutex;
+        std::condition_variable blockDone;
+        std::vector<std::unique_ptr<IoStream>> streams;
+        std::map<IoStream::Block*, std::shared_ptr<IoStream::Block>> inFlight;
+        bool stopping = false;
+
+        //the block buffers are recycled, they are aligned for direct IO
+        std::mutex bufferMutex;
+        std::vector<uint8_t*> freeBuffers;
+
+        Stats stats;
+        uint64_t lastBytesRead = 0;
+        std::chrono::steady_clock::time_point lastStatsTime;
+
+#if defined(SAKURAJIN_IO_URING) && SAKURAJIN_IO_URING
+        io_uring ring;
+#endif
+        bool ioUring = false;
+        std::thread completionThread;
+        std::unique_ptr<WorkerPool> fallbackPool;
+
+        uint8_t* acquireBuffer();
+        void releaseBuffer(uint8_t* buffer);
+
+        //the following functions expect the mutex to be locked
+        void scheduleWindow(IoStream& stream);
+        void submitQueued();
+        bool submit(const std::shared_ptr<IoStream::Block>& block);
+        void complete(IoStream::Block* block, int64_t result);
+
+        void completionLoop();
+    public:
+        IoScheduler();
+        explicit IoScheduler(const Config& config);
+        ~IoScheduler();
+
+        IoScheduler(const IoScheduler&) = delete;
+        IoScheduler& operator=(const IoScheduler&) = delete;
+
+        //returns nullptr if the file can't be opened, the stream stays valid until it is closed
+        IoStream* openStream(const std::string& filename);
+        void closeStream(IoStream* stream);
+
+        bool isUsingIoUring() const;
+        const Config& getConfig() const;
+        Stats getStats();
+    };
+}
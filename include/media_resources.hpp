@@ -0,0 +1,35 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+
+#include "clip_preloader.hpp"
+#include "frame_memory_pool.hpp"
+#include "io_scheduler.hpp"
+#include "packet_pool.hpp"
+#include "video_reader.hpp"
+
+namespace sakurajin{
+    //The pools that are shared by every tile and decoder. They are created once by
+    //the application and have to outlive everything that was opened with them.
+    struct MediaResources{
+        FrameMemoryPool& frameMemory;
+        PacketPool& packets;
+        //the readers read local files through the scheduler if there is one
+        IoScheduler* ioScheduler = nullptr;
+        //without a scheduler the readers map local files if this is set, otherwise they use read()
+        bool mapFiles = false;
+        //short clips are played from memory if there is a preloader
+        ClipPreloader* preloader = nullptr;
+        //set on the copy of a tile that is opened in the background, the readers stop once it is true
+        std::shared_ptr<const std::atomic<bool>> cancelled;
+
+        //get the preloaded content of a clip, this waits if it is still loading.
+        //Returns nullptr if there is no preloader or the clip isn't preloaded.
+        std::shared_ptr<PreloadedClip> loadClip(const std::string& filename) const;
+
+        //set up a reader before it is opened, the clip has to outlive the reader
+        void configureReader(VideoReaderState* reader, const PreloadedClip* clip) const;
+    };
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <memory>
+
+#include "render_graph.hpp"
+#include "shader_manager.hpp"
+
+namespace sakurajin{
+    //the global effects applied to the grid before it is shown
+    class OutputEffects{
+    public:
+        struct Settings{
+            bool gradeEnabled = false;
+            float brightness = 0.0f;
+            float contrast = 1.0f;
+            float saturation = 1.0f;
+
+            bool blurEnabled = false;
+            float blurRadius = 4.0f;
+
+            bool feedbackEnabled = false;
+            float feedbackAmount = 0.8f;
+        };
+
+        Settings settings;
+    private:
+        std::shared_ptr<Shader> gradeShader;
+        std::shared_ptr<Shader> blurShader;
+        std::shared_ptr<Shader> feedbackShader;
+        std::shared_ptr<Shader> copyShader;
+        
+        //the parameters are set every pass, so they are only looked up once
+        struct{
+            Shader::Uniform brightness, contrast, saturation;
+            Shader::Uniform blurDirection, blurRadius;
+            Shader::Uniform feedbackAmount;
+        } uniforms;
+
+        //full screen passes draw one triangle without any vertex data
+        unsigned int emptyVAO = 0;
+
+        //the feedback reads the previous output and writes the next one, the two targets swap every frame
+        std::shared_ptr<Framebuffer> history[2];
+        int historyIndex = 0;
+
+        void drawFullscreen();
+    public:
+        //the shaders are built by the manager, the passes can only run once it is ready
+        OutputEffects(ShaderManager& shaderManager);
+        ~OutputEffects();
+
+        OutputEffects(const OutputEffects&) = delete;
+        OutputEffects& operator=(const OutputEffects&) = delete;
+
+        //true if any effect is enabled, without effects the grid can be drawn straight to the output
+        bool isActive() const;
+
+        //effects that depend on the previous frame need a redraw every frame
+        bool needsContinuousRedraw() const;
+
+        //true once every effect program is built, the passes can't run before
+        bool isReady() const;
+
+        //declare the passes that take the input and write the final image to the output
+        void addPasses(RenderGraph& graph, FramebufferPool& pool, RenderGraph::ResourceHandle input, RenderGraph::ResourceHandle output, int width, int height);
+    };
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+}
+
+namespace sakurajin{
+    //Recycles the AVPacket and AVFrame objects of all readers, so opening another
+    //reader or decoder instance during playback doesn't have to allocate them.
+    //Released objects are unreferenced, their payload buffers go back to the
+    //buffer pools they came from. The pool can be used from any thread.
+    class PacketPool{
+    public:
+        struct Stats{
+            uint64_t packetAllocations = 0;
+            uint64_t frameAllocations = 0;
+            uint64_t reuses = 0;
+            size_t idlePackets = 0;
+            size_t idleFrames = 0;
+        };
+    private:
+        mutable std::mutex mutex;
+        std::vector<AVPacket*> packets;
+        std::vector<AVFrame*> frames;
+        Stats stats;
+    public:
+        //the preallocated objects cover the readers that are opened at startup
+        PacketPool(size_t preallocatedPackets = 0, size_t preallocatedFrames = 0);
+        ~PacketPool();
+
+        PacketPool(const PacketPool&) = delete;
+        PacketPool& operator=(const PacketPool&) = delete;
+
+        //both return nullptr if there is no idle object and allocating fails
+        AVPacket* acquirePacket();
+        AVFrame* acquireFrame();
+
+        //unreference the object and keep it for the next acquire, the pointer is cleared
+        void release(AVPacket*& packet);
+        void release(AVFrame*& frame);
+
+        Stats getStats() const;
+    };
+}
@@ -0,0 +1,45 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "video_tile.hpp"
+
+namespace sakurajin{
+    //Keeps the frame time inside the vsync budget by degrading the quality of single
+    //tiles, starting with the lowest priority. Once there is enough headroom again
+    //the quality is restored, starting with the highest priority.
+    class QualityGovernor{
+    private:
+        double frameBudget;
+        double smoothedWorkTime = 0.0;
+        double smoothedFrameInterval = 0.0;
+
+        //frames to wait after a decision so its effect shows up in the frame time
+        int cooldown = 0;
+        int headroomFrames = 0;
+
+        std::deque<std::string> decisions;
+
+        void logDecision(const std::string& decision);
+        bool degrade(const std::vector<std::unique_ptr<VideoTile>>& tiles);
+        bool restore(const std::vector<std::unique_ptr<VideoTile>>& tiles);
+    public:
+        //the budget is the time of one display refresh in seconds
+        QualityGovernor(double frameBudget);
+
+        void setFrameBudget(double frameBudget);
+        double getFrameBudget() const;
+
+        //workTime is the time spent on a frame without waiting for vsync,
+        //frameInterval is the full time since the last frame
+        void update(double workTime, double frameInterval, const std::vector<std::unique_ptr<VideoTile>>& tiles);
+
+        double getSmoothedWorkTime() const;
+
+        //the most recent decisions, the newest one is at the front
+        const std::deque<std::string>& getDecisions() const;
+    };
+}
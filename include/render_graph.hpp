@@ -0,0 +1,78 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "framebuffer_pool.hpp"
+
+namespace sakurajin{
+    //A small render graph. Passes are declared in execution order with the targets they
+    //read and the one target they write. Before executing, passes whose output never
+    //reaches an imported target are culled. Intermediate targets are only taken from the
+    //pool for the time between their writing pass and their last reader, so later passes
+    //reuse the same memory instead of every pass adding a full size buffer.
+    class RenderGraph{
+    public:
+        using ResourceHandle = size_t;
+
+        struct PassResources{
+            std::vector<Framebuffer*> inputs;
+            Framebuffer* output = nullptr;
+        };
+
+        //the output is bound and the inputs are bound to the texture units in order
+        using PassFunction = std::function<void(const PassResources& resources)>;
+    private:
+        struct Resource{
+            std::string name;
+            GLenum format = GL_RGBA8;
+            bool imported = false;
+            std::shared_ptr<Framebuffer> target;
+
+            //set while compiling
+            bool needed = false;
+            int lastReader = -1;
+        };
+
+        struct Pass{
+            std::string name;
+            std::vector<ResourceHandle> inputs;
+            ResourceHandle output;
+            PassFunction execute;
+            bool culled = true;
+        };
+
+        std::vector<Resource> resources;
+        std::vector<Pass> passes;
+        std::vector<int> writers;
+
+        size_t culledPassCount = 0;
+        size_t transientTargetCount = 0;
+
+        void compile();
+    public:
+        RenderGraph() = default;
+
+        //remove all passes and resources, call this before declaring the next frame
+        void reset();
+
+        //an intermediate target with the size of the graph, it only lives while it is needed
+        ResourceHandle createTarget(const std::string& name, GLenum format = GL_RGBA8);
+
+        //a target that is owned outside of the graph, writing to it keeps a pass alive
+        ResourceHandle importTarget(const std::string& name, std::shared_ptr<Framebuffer> target);
+
+        //every resource can only be written by one pass and has to be written before it is read
+        void addPass(const std::string& name, const std::vector<ResourceHandle>& inputs, ResourceHandle output, PassFunction execute);
+
+        //cull, allocate and run all passes, the intermediate targets get the given size
+        void execute(FramebufferPool& pool, int width, int height);
+
+        size_t getPassCount() const;
+        size_t getCulledPassCount() const;
+        size_t getTransientTargetCount() const;
+    };
+}
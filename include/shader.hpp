@@ -2,16 +2,23 @@
 
 #include "imguiHandler.hpp"
 
+#include <array>
 #include <filesystem>
 #include <fstream>
 #include <stdexcept>
 #include <iostream>
+#include <optional>
+#include <unordered_map>
+#include <utility>
+#include <vector>
 
 #include "helper.hpp"
 
 namespace sakurajin{
     class Shader_configuration{
     public:
+        using Defines = std::vector<std::pair<std::string, std::string>>;
+        
         std::filesystem::path vertex_shader_location = "";
         std::filesystem::path tessControl_shader_location = "";
         std::filesystem::path tessEvaluation_shader_location = "";
@@ -19,7 +26,12 @@ namespace sakurajin{
         std::filesystem::path fragment_shader_location = "";
         std::filesystem::path compute_shader_location = "";
         
+        //inserted as #define NAME VALUE after the #version line of every stage
+        Defines defines;
+        
         Shader_configuration(const std::filesystem::path& vertLoc, const std::filesystem::path& fragLoc);
+        //a compute program, it can't be combined with any other stage
+        explicit Shader_configuration(const std::filesystem::path& computeLoc);
         Shader_configuration(const Shader_configuration& other);
         Shader_configuration();
         
@@ -29,30 +41,123 @@ namespace sakurajin{
         bool hasTessEvaluationShader() const;
         bool hasGeometryShader() const;
         bool hasComputeShader() const;
+        bool isComputeOnly() const;
+        
+        //every stage that is set, used to find the programs that use a changed file
+        std::vector<std::filesystem::path> getStageLocations() const;
         
     };
     
     class Shader{
+    public:
+        //a uniform that was looked up once, setting it doesn't need a string lookup
+        struct Uniform{
+            int index = -1;
+        };
+        
+        //deferred only starts the build in the constructor, it has to be finished with pollBuild() or finishBuild()
+        enum class BuildMode{
+            immediate,
+            deferred
+        };
     private:
         unsigned int shaderProgram = 0;
         
+        //Uniforms are kept by name with the last value that was set. This way handles
+        //and values survive a rebuild of the program, and setting the same value
+        //again does not call into GL. The active uniforms are added after linking.
+        enum class ValueType{
+            none,
+            integer,
+            float1,
+            float2,
+            float3,
+            float4,
+            matrix4
+        };
+        struct UniformInfo{
+            std::string name;
+            int location = -1;
+            ValueType type = ValueType::none;
+            std::array<uint8_t, sizeof(glm::mat4)> value{};
+        };
+        std::vector<UniformInfo> uniforms;
+        std::unordered_map<std::string, int> uniformIndices;
+        
+        void resolveUniforms();
+        void applyUniform(const UniformInfo& uniform);
+        template<class T>
+        void storeUniform(Uniform uniform, ValueType type, const T& value);
+        
         Shader_configuration shader_config;
         
-        int createShader();
+        //a program that is still compiling or linking, it replaces the current one once it is done
+        struct PendingBuild{
+            unsigned int program = 0;
+            std::vector<unsigned int> shaders;
+            uint64_t sourceHash = 0;
+            bool fromCache = false;
+        };
+        std::optional<PendingBuild> pendingBuild;
+        void discardPendingBuild();
         
-        int compileShader(std::string code, unsigned int& shaderLoc, int shaderType);
+        unsigned int compileShader(const std::string& code, int shaderType);
+        
+        //the code of every stage, in the order they are attached
+        struct ShaderSource{
+            int type;
+            std::string code;
+        };
+        std::vector<ShaderSource> loadSources();
+        std::string injectDefines(const std::string& code) const;
+        static uint64_t hashSources(const std::vector<ShaderSource>& sources);
+        
+        void queryProgramInfo();
+        
+        //the local size from the compute shader, all 0 for graphics programs
+        std::array<int, 3> workGroupSize{0, 0, 0};
         
         std::string loadFile(std::filesystem::path location);
     public:
         Shader(const Shader_configuration& config);
         Shader(Shader_configuration config);
+        Shader(const Shader_configuration& config, BuildMode mode);
         
         Shader(const std::filesystem::path& vertLoc, const std::filesystem::path& fragLoc);
+        explicit Shader(const std::filesystem::path& computeLoc);
         
         ~Shader();
         
+        Shader(const Shader&) = delete;
+        Shader& operator=(const Shader&) = delete;
+        
         void use();
         
+        //read the files again and start compiling them, the current program
+        //stays in use until the new one is finished successfully
+        void startBuild();
+        
+        //true if the pending build can be finished without waiting for the driver.
+        //Without GL_KHR_parallel_shader_compile this is always true.
+        bool isBuildDone() const;
+        
+        //finish the pending build and wait for the driver if needed. On success the new
+        //program replaces the current one, on failure the current one is kept and the error is thrown.
+        void finishBuild();
+        
+        //finish the pending build if the driver is done, returns true if a new program is in use
+        bool pollBuild();
+        
+        bool isBuilding() const;
+        
+        //false until the first build was finished
+        bool isReady() const;
+        
+        const Shader_configuration& getConfiguration() const;
+        
+        //true if the driver compiles in the background and the build status can be polled
+        static bool hasParallelCompile();
+        
         void setUniform(const std::string& location, int value);
         void setUniform(const std::string& location, glm::vec1 value);
         void setUniform(const std::string& location, glm::vec2 value);
@@ -60,5 +165,42 @@ namespace sakurajin{
         void setUniform(const std::string& location, glm::vec4 value);
         void setUniform(const std::string& location, const glm::mat4& value);
         
+        //look up a uniform once and set it through the handle. Names that are not used
+        //by the program are ignored (like location -1 in GL), but their value is kept in
+        //case a rebuilt program uses them.
+        Uniform getUniform(const std::string& name);
+        
+        //the values are set on the program directly, so it doesn't have to be in use
+        void setUniform(Uniform uniform, int value);
+        void setUniform(Uniform uniform, glm::vec1 value);
+        void setUniform(Uniform uniform, glm::vec2 value);
+        void setUniform(Uniform uniform, glm::vec3 value);
+        void setUniform(Uniform uniform, glm::vec4 value);
+        void setUniform(Uniform uniform, const glm::mat4& value);
+        
+        //assign a uniform block to a binding point, returns false if the program has no such block
+        bool bindUniformBlock(const std::string& blockName, unsigned int binding);
+        
+        bool isCompute() const;
+        std::array<int, 3> getWorkGroupSize() const;
+        
+        //run the compute program with the given number of work groups, the program has to be in use
+        void dispatch(unsigned int groupsX, unsigned int groupsY = 1, unsigned int groupsZ = 1);
+        
+        //run enough work groups to cover every element of a width x height x depth grid,
+        //the shader has to skip the invocations outside of the grid itself
+        void dispatchForSize(unsigned int width, unsigned int height = 1, unsigned int depth = 1);
+        
+        //bind a texture level to an image unit, a layer of -1 binds all layers of an array texture
+        static void bindImage(unsigned int unit, unsigned int texture, GLenum access, GLenum format = GL_RGBA8, int level = 0, int layer = -1);
+        
+        //bind a whole buffer or a part of it to a shader storage block binding
+        static void bindStorageBuffer(unsigned int binding, unsigned int buffer);
+        static void bindStorageBuffer(unsigned int binding, unsigned int buffer, GLintptr offset, GLsizeiptr size);
+        
+        //make the writes of a dispatch visible to the following reads, the bits describe how
+        //the data is read afterwards (e.g. GL_TEXTURE_FETCH_BARRIER_BIT for sampling the result)
+        static void memoryBarrier(GLbitfield barriers);
+        
     };
 }
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <filesystem>
+#include <string>
+
+#include "imguiHandler.hpp"
+
+namespace sakurajin{
+    //Stores linked programs with glGetProgramBinary, so the next start can skip compiling.
+    //The files are named after the hash of the sources and also contain the driver they
+    //were created with. A binary from another driver or one the driver rejects is ignored
+    //and replaced by the freshly linked program.
+    class ShaderCache{
+    private:
+        static std::string getDriverString();
+        static std::filesystem::path getCacheFile(uint64_t sourceHash);
+    public:
+        //FNV-1a, stable between runs unlike std::hash
+        static uint64_t hash(const void* data, size_t size, uint64_t seed = 0xcbf29ce484222325ull);
+
+        //$XDG_CACHE_HOME/video-app/shaders or ~/.cache/video-app/shaders,
+        //empty if neither is set, which disables the cache
+        static std::filesystem::path getCacheDirectory();
+
+        //load a cached binary into the program, returns true if the program is linked afterwards
+        static bool load(unsigned int program, uint64_t sourceHash);
+
+        //write the binary of a linked program, failing to do so only prints a warning
+        static void store(unsigned int program, uint64_t sourceHash);
+    };
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <filesystem>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "shader.hpp"
+
+namespace sakurajin{
+    //Owns the shaders of the application and builds them without blocking the render loop.
+    //All builds are started when a shader is loaded, with GL_KHR_parallel_shader_compile the
+    //driver compiles them on its own threads and update() only picks up finished programs.
+    //The source files are watched with inotify, a changed file starts a rebuild and the new
+    //program replaces the old one once it built successfully.
+    class ShaderManager{
+    private:
+        struct ShaderEntry{
+            std::shared_ptr<Shader> shader;
+            std::vector<std::filesystem::path> files;
+        };
+        std::vector<ShaderEntry> shaders;
+
+        int inotifyFd = -1;
+        std::unordered_map<int, std::filesystem::path> watchedDirectories;
+
+        uint64_t reloadCount = 0;
+        std::string lastError;
+
+        void watchFiles(ShaderEntry& entry);
+        std::vector<std::filesystem::path> readChangedFiles();
+    public:
+        //hot reload is only possible if the build allows overriding the embedded shaders
+        ShaderManager(bool hotReload = true);
+        ~ShaderManager();
+
+        ShaderManager(const ShaderManager&) = delete;
+        ShaderManager& operator=(const ShaderManager&) = delete;
+
+        //start building a shader, it can't be used before isReady() returns true
+        std::shared_ptr<Shader> load(const Shader_configuration& config);
+        std::shared_ptr<Shader> load(const std::filesystem::path& vertLoc, const std::filesystem::path& fragLoc);
+
+        //finish the builds the driver is done with and rebuild shaders with changed files,
+        //this never waits for the driver. Returns true if a program was replaced.
+        //A failing first build is thrown, a failing rebuild only keeps the old program.
+        bool update();
+
+        //wait until every pending build is finished
+        void finishAll();
+
+        //true once every shader has a program
+        bool isReady() const;
+
+        size_t getBuildingCount() const;
+        uint64_t getReloadCount() const;
+        const std::string& getLastError() const;
+    };
+}
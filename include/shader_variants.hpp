@@ -0,0 +1,87 @@
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+extern "C" {
+#include <libavutil/pixfmt.h>
+}
+
+#include "shader_manager.hpp"
+
+namespace sakurajin{
+    //the layout of the frame data a tile shader samples
+    enum class PixelFormat : uint8_t{
+        rgba,
+        yuv420p,
+        nv12
+    };
+
+    //the YUV to RGB matrix, only used by the YUV formats
+    enum class ColorMatrix : uint8_t{
+        bt601,
+        bt709,
+        bt2020
+    };
+
+    //limited (16-235) or full (0-255) YUV values, only used by the YUV formats
+    enum class ColorRange : uint8_t{
+        limited,
+        full
+    };
+
+    //opaque ignores the alpha of the frame, straight alpha is premultiplied in the shader
+    enum class AlphaMode : uint8_t{
+        opaque,
+        straight,
+        premultiplied
+    };
+
+    //Everything a tile shader is specialized on. Each combination is compiled into its own
+    //program with #defines, so no shader has to branch on these values per pixel.
+    struct ShaderVariantKey{
+        PixelFormat pixelFormat = PixelFormat::rgba;
+        ColorMatrix colorMatrix = ColorMatrix::bt709;
+        ColorRange colorRange = ColorRange::limited;
+        AlphaMode alphaMode = AlphaMode::opaque;
+
+        //the tile is colour graded with the brightness, contrast and saturation of its instance
+        bool grade = false;
+
+        //get the key from the colour description of a stream, the height of the stream
+        //decides the matrix if the stream doesn't specify its colour space
+        static ShaderVariantKey fromStream(AVPixelFormat format, AVColorSpace colorSpace, AVColorRange range, int height);
+
+        //pack the key into a few bits, values that don't change the shader are left out,
+        //so e.g. every RGBA variant with the same alpha mode gets the same key
+        uint32_t pack() const;
+        static ShaderVariantKey unpack(uint32_t packed);
+
+        //the #defines for the shader sources and a short description for the UI
+        Shader_configuration::Defines getDefines() const;
+        std::string describe() const;
+    };
+
+    //Builds one specialized program per used key through the shader manager.
+    //The programs are created on first use and kept for the rest of the run.
+    class ShaderVariants{
+    private:
+        ShaderManager& shaderManager;
+        Shader_configuration baseConfiguration;
+        std::function<void(Shader&)> setup;
+
+        std::unordered_map<uint32_t, std::shared_ptr<Shader>> variants;
+    public:
+        //setup is called once for every new variant, e.g. to assign the samplers
+        ShaderVariants(ShaderManager& shaderManager, const Shader_configuration& baseConfiguration, std::function<void(Shader&)> setup = {});
+
+        //get the program for a key, a new variant is not ready until the manager built it
+        std::shared_ptr<Shader> get(const ShaderVariantKey& key);
+        std::shared_ptr<Shader> get(uint32_t packedKey);
+
+        size_t getVariantCount() const;
+    };
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "frame_view.hpp"
+#include "video_tile.hpp"
+
+namespace sakurajin{
+    //Lets grid slots that show the same clip share one decoder. Only the first tile
+    //playing a stream of a clip decodes it, every other slot showing that stream is a mirror of it.
+    //A mirror without delay draws the layers of its source, so the frame is decoded
+    //and uploaded once. A delayed mirror shows frames from the history of its source
+    //and only uploads those into its own layer.
+    class SharedDecode{
+    public:
+        //how far a mirror can lag behind its source
+        static constexpr double maxDelay = 4.0;
+
+        //the frame data the history of one source may keep alive, with large frames
+        //a delayed mirror lags less than requested instead
+        static constexpr size_t maxHistoryBytes = 256 * 1024 * 1024;
+
+        struct Mirror{
+            std::string filename;
+            int stream = 0;
+            bool reverse = false;
+            double delay = 0.0;
+            bool shown = true;
+        };
+
+        //a mirror has no source while no tile plays its clip
+        static constexpr size_t noSource = static_cast<size_t>(-1);
+    private:
+        struct MirrorState{
+            Mirror mirror;
+            size_t source = noSource;
+            //the time of the delayed frame in the layer of the mirror
+            bool uploaded = false;
+            double uploadedTime = 0.0;
+        };
+
+        std::vector<MirrorState> mirrors;
+
+        //the tiles that have to decode visible frames because a mirror shows them
+        std::vector<char> feedsMirror;
+    public:
+        //the tile that plays the stream of the clip, noSource if there is none
+        static size_t findSource(const std::vector<std::unique_ptr<VideoTile>>& tiles, const std::string& filename, int stream, bool reverse);
+
+        void addMirror(const Mirror& mirror);
+        size_t getMirrorCount() const;
+        Mirror& getMirror(size_t mirror);
+
+        //find the source of every mirror and let the sources keep enough history for
+        //their delayed mirrors. Call this every tick before the tiles are updated.
+        void resolveSources(const std::vector<std::unique_ptr<VideoTile>>& tiles);
+        size_t getSource(size_t mirror) const;
+
+        //if a hidden tile still has to decode visible frames for its mirrors
+        bool isFeedingMirror(size_t tile) const;
+
+        //the frame a delayed mirror shows now, invalid if it has no source or no delay
+        const FrameView& getDelayedFrame(size_t mirror, const std::vector<std::unique_ptr<VideoTile>>& tiles) const;
+
+        //check if the delayed frame of a mirror changed since it was last uploaded and
+        //mark it as uploaded. Returns false for mirrors that share the layers of their source.
+        bool takeUpload(size_t mirror, const std::vector<std::unique_ptr<VideoTile>>& tiles);
+
+        //the layers were reallocated, every delayed mirror has to be uploaded again
+        void invalidateUploads();
+    };
+}
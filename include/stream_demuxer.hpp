@@ -0,0 +1,75 @@
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "media_resources.hpp"
+#include "video_reader.hpp"
+
+namespace sakurajin{
+    //Reads a file with several video streams once and hands the packets of every
+    //stream to the reader that decodes it, so multi-angle recordings are only
+    //demuxed once however many of their streams are shown. A reader asks for the
+    //next packet of its stream, the packets of the other streams that are read on
+    //the way are queued for their readers. Streams without a reader are dropped.
+    //A queue that grows past its byte limit because its reader fell behind or was
+    //paused is dropped, and its reader continues at the next keyframe of the stream.
+    class StreamDemuxer{
+    public:
+        static constexpr size_t defaultMaxQueuedBytes = 64 * 1024 * 1024;
+    private:
+        struct StreamQueue{
+            int consumers = 0;
+            std::deque<AVPacket*> packets;
+            size_t bytes = 0;
+            //set after the queue was dropped, the packets up to the next keyframe can't be decoded
+            bool resync = false;
+        };
+
+        std::string filename;
+        MediaResources resources;
+        size_t maxQueuedBytes;
+        std::shared_ptr<PreloadedClip> preloadedClip;
+        VideoReaderState input;
+
+        //the readers decode on different threads, so reading and the queues are shared
+        std::mutex demuxMutex;
+        std::vector<StreamQueue> queues;
+        std::vector<int> videoStreams;
+        AVPacket* demuxPacket = nullptr;
+
+        void clearQueue(StreamQueue& queue);
+        bool waitsForKeyframe(StreamQueue& queue, const AVPacket* packet);
+    public:
+        StreamDemuxer(const std::string& filename, const MediaResources& resources, size_t maxQueuedBytes = defaultMaxQueuedBytes);
+        ~StreamDemuxer();
+
+        StreamDemuxer(const StreamDemuxer&) = delete;
+        StreamDemuxer& operator=(const StreamDemuxer&) = delete;
+
+        const std::string& getFilename() const;
+
+        //the memory the file is demuxed from, nullptr if it is read from the file
+        std::shared_ptr<PreloadedClip> getPreloadedClip() const;
+
+        //the number of decodable video streams, a reader picks one with requested_stream
+        size_t getVideoStreamCount() const;
+
+        //the format context of the file, it is owned by the demuxer
+        AVFormatContext* getFormatContext() const;
+
+        //register a reader of a stream, only streams with a reader keep their packets
+        void addConsumer(int streamIndex);
+        void removeConsumer(int streamIndex);
+
+        //move the next packet of a stream into packet, this demuxes until there is one.
+        //Returns the error of av_read_frame() once the file has no more packets for the stream.
+        int readPacket(int streamIndex, AVPacket* packet);
+
+        //the packets that wait for their reader, a paused reader lets its queue grow up to the byte limit
+        size_t getQueuedPacketCount();
+    };
+}
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "imguiHandler.hpp"
+
+namespace sakurajin{
+    //A uniform buffer object for a parameter block that is shared by several programs.
+    //The buffer keeps a copy of its content, so updates with unchanged data are skipped.
+    class UniformBuffer{
+    private:
+        unsigned int buffer = 0;
+        std::vector<uint8_t> content;
+        uint64_t uploadCount = 0;
+    public:
+        UniformBuffer(size_t size);
+        ~UniformBuffer();
+
+        UniformBuffer(const UniformBuffer&) = delete;
+        UniformBuffer& operator=(const UniformBuffer&) = delete;
+
+        //write data at the offset, returns true if it was different and uploaded
+        bool update(const void* data, size_t size, size_t offset = 0);
+
+        //the struct has to follow the std140 layout of the block
+        template<class T>
+        bool update(const T& data){
+            return update(&data, sizeof(T));
+        }
+
+        //bind the whole buffer to a uniform block binding point
+        void bind(unsigned int binding) const;
+
+        unsigned int getBuffer() const;
+        size_t getSize() const;
+        uint64_t getUploadCount() const;
+    };
+
+    //The per frame block of the output shaders (uniform Frame at binding 0).
+    //It is std140, so every member has to be a vec4 or mat4.
+    struct FrameUniforms{
+        static constexpr unsigned int binding = 0;
+
+        glm::mat4 projection{1.0f};
+        //x,y are the size of the output in pixels
+        glm::vec4 outputSize{0.0f};
+    };
+}
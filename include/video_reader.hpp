@@ -8,23 +8,130 @@ extern "C" {
 #include <inttypes.h>
 }
 
+#include <atomic>
+#include <functional>
+#include <mutex>
+#include <vector>
+
+namespace sakurajin {
+class PacketPool;
+class IoScheduler;
+class IoStream;
+class StreamDemuxer;
+}
+
 struct VideoReaderState {
     // Public things for other parts of the program to read from
     int width, height;
     AVRational time_base;
 
+    // Colour description of the decoded frames, taken from the stream parameters
+    AVPixelFormat pixel_format = AV_PIX_FMT_NONE;
+    AVColorSpace color_space = AVCOL_SPC_UNSPECIFIED;
+    AVColorRange color_range = AVCOL_RANGE_UNSPECIFIED;
+
+    // Size of the frames written by video_reader_convert_frame(). This is the
+    // native size unless a smaller display size was set with
+    // video_reader_set_output_size().
+    int output_width = 0, output_height = 0;
+
+    // Quality trade-offs set with video_reader_set_quality(). The LOD bias picks
+    // that many LOD steps below the display size.
+    int lod_bias = 0;
+    int scale_flags = SWS_BILINEAR;
+    AVDiscard skip_loop_filter = AVDISCARD_DEFAULT;
+
+    // Set once the demuxer ran out of packets, the last decoded frame stays valid
+    bool end_of_stream = false;
+
+    // Presentation timestamps of every keyframe, sorted ascending.
+    // Only filled after calling video_reader_build_keyframe_index().
+    std::vector<int64_t> keyframe_index;
+
+    // Local files are demuxed from a memory mapping instead of read() calls if
+    // this is set before video_reader_open(). Inputs that can't be mapped, like
+    // network streams, always use the default protocol. The demuxer still copies
+    // every read out of the mapping into its own buffer, only the read() syscalls
+    // go away, and a file that is truncated while it is mapped raises SIGBUS.
+    bool use_mmap = false;
+
+    // If set before video_reader_open(), local files are read ahead through this
+    // scheduler instead of being mapped
+    sakurajin::IoScheduler* io_scheduler = NULL;
+
+    // If set before video_reader_open(), the file is demuxed from this memory
+    // instead, which has to stay valid until video_reader_close()
+    const uint8_t* memory_data = NULL;
+    size_t memory_size = 0;
+
+    // If set before video_reader_open(), the packet and frame are taken from
+    // this pool and given back by video_reader_close()
+    sakurajin::PacketPool* packet_pool = NULL;
+
+    // If set before video_reader_open(), opening and reading stop with an error once
+    // it is true, so another thread can cancel a slow open. The flag has to stay
+    // valid until video_reader_close().
+    const std::atomic<bool>* abort_flag = NULL;
+
+    // If set before video_reader_open(), the video stream with this number is
+    // decoded instead of the first one. Only video streams are counted.
+    int requested_stream = 0;
+
+    // If set before video_reader_open(), the packets come from this demuxer, which
+    // reads the file once for all of its streams. The format context belongs to the
+    // demuxer then and the reader can't seek.
+    sakurajin::StreamDemuxer* demuxer = NULL;
+
     // Private internal state
-    AVFormatContext* av_format_ctx;
-    AVCodecContext* av_codec_ctx;
-    int video_stream_index;
-    AVFrame* av_frame;
-    AVPacket* av_packet;
-    SwsContext* sws_scaler_ctx;
+    AVFormatContext* av_format_ctx = NULL;
+    // The scheduled stream or the mapped file or memory behind the custom AVIOContext,
+    // the position is the next byte the demuxer reads and the readahead hints for a
+    // mapped file reach up to mapped_advised_end
+    AVIOContext* av_io_ctx = NULL;
+    sakurajin::IoStream* io_stream = NULL;
+    const uint8_t* mapped_data = NULL;
+    size_t mapped_size = 0;
+    size_t mapped_position = 0;
+    size_t mapped_advised_end = 0;
+    bool mapped_file = false;
+    AVCodecContext* av_codec_ctx = NULL;
+    int video_stream_index = -1;
+    AVFrame* av_frame = NULL;
+    AVPacket* av_packet = NULL;
+    SwsContext* sws_scaler_ctx = NULL;
+    // Decoder output buffers for the formats that are uploaded without conversion,
+    // see video_reader_ref_frame(). The decoder threads share the pool.
+    std::mutex frame_pool_mutex;
+    AVBufferPool* frame_pool = NULL;
+    size_t frame_pool_size = 0;
+    int lowres = 0;
+    int requested_lowres = 0;
+    // Set while the decoder is flushed at the end of the stream or before a lowres
+    // switch, av_packet holds the keyframe for the new decoder if packet_pending is set
+    bool decoder_draining = false;
+    bool packet_pending = false;
+    bool reference_only = false;
 };
 
 bool video_reader_open(VideoReaderState* state, const char* filename);
+bool video_reader_open_input(VideoReaderState* state, const char* filename);
+bool video_reader_is_video_stream(const AVStream* stream);
+bool video_reader_is_mapped(const VideoReaderState* state);
+bool video_reader_is_in_memory(const VideoReaderState* state);
+bool video_reader_demux_to_end(VideoReaderState* state, uint64_t* packet_count, uint64_t* byte_count);
 bool video_reader_read_frame(VideoReaderState* state, uint8_t* frame_buffer, int64_t* pts);
+bool video_reader_decode_frame(VideoReaderState* state, int64_t* pts);
+bool video_reader_convert_frame(VideoReaderState* state, uint8_t* frame_buffer);
+bool video_reader_convert_frame_from(VideoReaderState* state, const AVFrame* frame, uint8_t* frame_buffer);
+bool video_reader_ref_frame(VideoReaderState* state, AVFrame* frame);
+bool video_reader_is_native_format(int format);
 bool video_reader_seek_frame(VideoReaderState* state, int64_t ts);
+void video_reader_set_output_size(VideoReaderState* state, int display_width, int display_height);
+void video_reader_set_reference_only(VideoReaderState* state, bool reference_only);
+void video_reader_set_quality(VideoReaderState* state, int lod_bias, int scale_flags, AVDiscard skip_loop_filter);
+bool video_reader_build_keyframe_index(VideoReaderState* state);
+bool video_reader_decode_gop(VideoReaderState* state, int64_t start_pts, int64_t end_pts,
+                             const std::function<bool(int64_t pts)>& on_frame);
 void video_reader_close(VideoReaderState* state);
 
 #endif
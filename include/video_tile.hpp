@@ -0,0 +1,178 @@
+#pragma once
+
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "imguiHandler.hpp"
+#include "video_reader.hpp"
+#include "gop_decoder.hpp"
+#include "media_resources.hpp"
+#include "shader_variants.hpp"
+#include "stream_demuxer.hpp"
+#include "frame_view.hpp"
+
+namespace sakurajin{
+    //one video in the output grid, it owns the reader and the data of the current frame.
+    //YUV420P and NV12 frames at the LOD size keep a reference to the decoder output and
+    //are converted by the tile shader, every other frame is converted to RGBA at the LOD
+    //size on the CPU.
+    class VideoTile{
+    public:
+        enum class PlaybackState{
+            playing,
+            paused
+        };
+
+        //quality level 0 is full quality, every level above it is cheaper to decode and show
+        static constexpr int maxQualityLevel = 4;
+    private:
+        std::string filename;
+        MediaResources resources;
+        std::shared_ptr<PreloadedClip> preloadedClip;
+        //the demuxer the reader shares with the tiles of the other streams of the file
+        std::shared_ptr<StreamDemuxer> demuxer;
+        int stream = 0;
+        VideoReaderState reader;
+        std::unique_ptr<GopDecoder> gopDecoder;
+
+        //the RGBA data of the shown frame, it is either converted for the current LOD
+        //or shared with the GOP decoder
+        FrameMemory frameData;
+
+        //the decoder output of the shown frame if it is uploaded without conversion
+        AVFrame* nativeFrame = nullptr;
+
+        //the frame that is shown right now, it stays valid until the next update
+        FrameView currentFrame;
+
+        //the recently shown frames for mirrors that show the clip delayed, each one
+        //keeps its converted data or decoder output alive. The frames are kept in a ring
+        //that only grows while the history fills up, later frames reuse its slots.
+        struct HistoryFrame{
+            double time = 0.0;
+            FrameView frame;
+            FrameMemory data;
+            AVFrame* native = nullptr;
+            size_t bytes = 0;
+        };
+        std::vector<HistoryFrame> history;
+        size_t historyFirst = 0;
+        size_t historyCount = 0;
+        double historyLength = 0.0;
+        //the frame data the history keeps alive, the oldest frames are dropped above the limit
+        size_t historyBytes = 0;
+        size_t historyByteLimit = 0;
+
+        //the playback clock, the playhead is the time since the first frame in seconds
+        PlaybackState playbackState = PlaybackState::playing;
+        bool visible = true;
+        double playhead = 0.0;
+        int64_t firstPts = AV_NOPTS_VALUE;
+        int64_t pts = 0;
+
+        //higher priority tiles are degraded last by the quality governor
+        int priority = 0;
+        int qualityLevel = 0;
+        int frameStep = 1;
+        int64_t presentedFrames = 0;
+
+        //the next decoded frame, it is shown once the playhead reaches it
+        bool hasPendingFrame = false;
+        bool preparedFrame = false;
+        bool finished = false;
+        int64_t pendingPts = 0;
+        FrameMemory pendingGopFrame;
+
+        //the newest frame the playhead reached, it is taken out of the decoder before the
+        //next one is decoded and only converted or referenced once the catch-up is done
+        bool hasDueFrame = false;
+        AVFrame* dueFrame = nullptr;
+        FrameMemory dueGopFrame;
+
+        double getFrameTime(int64_t framePts) const;
+        bool decodeNextFrame();
+        bool takePendingFrame();
+        bool presentDueFrame();
+        bool isLodSize(const AVFrame* frame) const;
+        bool presentNativeFrame();
+        void setFrame(FrameMemory data, int width, int height);
+        void acquireFrames();
+        void addToHistory();
+        void pruneHistory(double keepAfter);
+        void dropOldestHistoryFrame();
+        //the frame at the given position of the history, 0 is the oldest one
+        HistoryFrame& historyAt(size_t index);
+        const HistoryFrame& historyAt(size_t index) const;
+    public:
+        //the frame buffers, packets, frames and reads come from the shared resources
+        VideoTile(const std::string& filename, const MediaResources& resources, bool reverse = false);
+
+        //play one video stream of a file that is demuxed once for all of its streams,
+        //this only plays forward
+        VideoTile(std::shared_ptr<StreamDemuxer> demuxer, int stream, const MediaResources& resources);
+        ~VideoTile();
+
+        VideoTile(const VideoTile&) = delete;
+        VideoTile& operator=(const VideoTile&) = delete;
+
+        //set the size the tile covers on screen, the reader picks a matching LOD
+        void setDisplaySize(int width, int height);
+
+        //hidden tiles keep their time but only decode reference frames and convert nothing
+        void setVisible(bool visible);
+        bool isVisible() const;
+
+        //paused tiles do not decode at all and keep their playhead
+        void setPlaybackState(PlaybackState state);
+        PlaybackState getPlaybackState() const;
+
+        void setPriority(int priority);
+        int getPriority() const;
+
+        //apply one of the predefined quality levels. Reverse tiles have fewer levels,
+        //their decoder can only drop frames.
+        void setQualityLevel(int level);
+        int getQualityLevel() const;
+        int getMaxQualityLevel() const;
+        const char* getQualityDescription() const;
+
+        //decode and show the first frame without starting the clock, so the tile can be
+        //warmed up on another thread before it is shown. Returns false if there is no frame.
+        bool prepare();
+
+        //advance the playhead and decode the due frames,
+        //returns true if there is a new frame that has to be uploaded
+        bool update(double deltaSeconds);
+
+        //the planes of the current frame, invalid before the first frame was shown
+        const FrameView& getFrame() const;
+
+        //keep the frames of the last seconds, so mirrors can show the clip delayed.
+        //The history is shorter if its frames would need more than maxBytes.
+        void setHistoryLength(double seconds, size_t maxBytes);
+
+        //the frame that was shown the given seconds ago, or the oldest kept frame
+        //if the history doesn't reach back that far. The time of the frame on the
+        //playhead is written to frameTime.
+        const FrameView& getDelayedFrame(double delay, double& frameTime) const;
+        int getFrameWidth() const;
+        int getFrameHeight() const;
+        float getAspectRatio() const;
+        
+        //the shader variant the frame data has to be drawn with
+        ShaderVariantKey getShaderVariant() const;
+        int64_t getPts() const;
+        double getPlayhead() const;
+        bool isFinished() const;
+        bool isReverse() const;
+        const std::string& getFilename() const;
+
+        //the number of the video stream in the file
+        int getStream() const;
+
+        //the memory the clip is played from, nullptr if it is read from the file
+        const PreloadedClip* getPreloadedClip() const;
+    };
+}
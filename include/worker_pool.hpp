@@ -0,0 +1,49 @@
+#pragma once
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace sakurajin{
+    class WorkerPool{
+    private:
+        std::vector<std::thread> workers;
+        std::deque<std::function<void()>> jobs;
+
+        std::mutex jobMutex;
+        std::condition_variable jobAvailable;
+        bool stopping = false;
+
+        void workerLoop();
+        void enqueue(std::function<void()> job);
+    public:
+        //a thread count of 0 uses one worker per hardware thread
+        WorkerPool(unsigned int threadCount = 0);
+        ~WorkerPool();
+
+        WorkerPool(const WorkerPool&) = delete;
+        WorkerPool& operator=(const WorkerPool&) = delete;
+
+        unsigned int size() const;
+
+        //queue a job and get a future for its result, exceptions are forwarded to the future
+        template<class Function>
+        auto submit(Function&& job) -> std::future<std::invoke_result_t<Function>>{
+            using result_t = std::invoke_result_t<Function>;
+
+            //std::function needs a copyable callable, so the task is shared
+            auto task = std::make_shared<std::packaged_task<result_t()>>(std::forward<Function>(job));
+            auto result = task->get_future();
+
+            enqueue([task](){ (*task)(); });
+
+            return result;
+        }
+    };
+}
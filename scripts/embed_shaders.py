@@ -0,0 +1,47 @@
+#!/usr/bin/env python3
+# Writes a C++ file with the content of the given shader files, so the default
+# shaders are part of the binary. Used by meson.build, see include/embedded_shaders.hpp.
+
+import argparse
+import os
+
+
+def main():
+    parser = argparse.ArgumentParser(description='embed shader files into a C++ source file')
+    parser.add_argument('--root', required=True, help='the files are stored relative to this directory')
+    parser.add_argument('--output', required=True, help='the generated C++ file')
+    parser.add_argument('files', nargs='+')
+    args = parser.parse_args()
+
+    entries = []
+    for index, path in enumerate(args.files):
+        with open(path, 'r', encoding='utf-8') as shader_file:
+            content = shader_file.read()
+
+        # the lookup uses the same relative path the application passes to Shader
+        location = os.path.relpath(os.path.abspath(path), os.path.abspath(args.root)).replace(os.sep, '/')
+
+        delimiter = 'shader'
+        while ')' + delimiter + '"' in content:
+            delimiter += '_'
+
+        entries.append((index, location, delimiter, content))
+
+    with open(args.output, 'w', encoding='utf-8') as output:
+        output.write('// generated by scripts/embed_shaders.py, do not edit\n')
+        output.write('#include "embedded_shaders.hpp"\n\n')
+        output.write('namespace{\n')
+        for index, location, delimiter, content in entries:
+            output.write('    // {}\n'.format(location))
+            output.write('    constexpr char shader_{}[] = R"{}({}){}";\n\n'.format(index, delimiter, content, delimiter))
+        output.write('}\n\n')
+
+        output.write('const sakurajin::EmbeddedShaders::File sakurajin::EmbeddedShaders::files[] = {\n')
+        for index, location, delimiter, content in entries:
+            output.write('    {{"{}", {{shader_{}, sizeof(shader_{}) - 1}}}},\n'.format(location, index, index))
+        output.write('};\n\n')
+        output.write('const size_t sakurajin::EmbeddedShaders::fileCount = {};\n'.format(len(entries)))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,99 @@
+#include "allocation_counter.hpp"
+
+#include <atomic>
+#include <cerrno>
+
+namespace{
+    std::atomic<bool> counting{false};
+    std::atomic<uint64_t> allocationCount{0};
+    std::atomic<uint64_t> allocatedBytes{0};
+    thread_local int pauseDepth = 0;
+
+    [[maybe_unused]] void countAllocation(size_t size){
+        if(!counting.load(std::memory_order_relaxed) || pauseDepth > 0){
+            return;
+        }
+        allocationCount.fetch_add(1, std::memory_order_relaxed);
+        allocatedBytes.fetch_add(size, std::memory_order_relaxed);
+    }
+}
+
+#if defined(SAKURAJIN_ALLOCATION_COUNTER) && SAKURAJIN_ALLOCATION_COUNTER
+
+//Replacing the allocation functions in the executable also catches the allocations of
+//FFmpeg and every other shared library. The real implementations are the glibc internals.
+extern "C" {
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* pointer, size_t size);
+    void* __libc_memalign(size_t alignment, size_t size);
+    void __libc_free(void* pointer);
+
+    void* malloc(size_t size){
+        countAllocation(size);
+        return __libc_malloc(size);
+    }
+
+    void* calloc(size_t count, size_t size){
+        countAllocation(count * size);
+        return __libc_calloc(count, size);
+    }
+
+    void* realloc(void* pointer, size_t size){
+        countAllocation(size);
+        return __libc_realloc(pointer, size);
+    }
+
+    void free(void* pointer){
+        __libc_free(pointer);
+    }
+
+    void* memalign(size_t alignment, size_t size){
+        countAllocation(size);
+        return __libc_memalign(alignment, size);
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size){
+        countAllocation(size);
+        return __libc_memalign(alignment, size);
+    }
+
+    int posix_memalign(void** pointer, size_t alignment, size_t size){
+        countAllocation(size);
+        void* result = __libc_memalign(alignment, size);
+        if(!result){
+            return ENOMEM;
+        }
+        *pointer = result;
+        return 0;
+    }
+}
+
+#endif
+
+sakurajin::AllocationCounter::Pause::Pause() {
+    pauseDepth++;
+}
+
+sakurajin::AllocationCounter::Pause::~Pause() {
+    pauseDepth--;
+}
+
+bool sakurajin::AllocationCounter::isAvailable() {
+#if defined(SAKURAJIN_ALLOCATION_COUNTER) && SAKURAJIN_ALLOCATION_COUNTER
+    return true;
+#else
+    return false;
+#endif
+}
+
+void sakurajin::AllocationCounter::start() {
+    allocationCount = 0;
+    allocatedBytes = 0;
+    counting = true;
+}
+
+sakurajin::AllocationCounter::Count sakurajin::AllocationCounter::stop() {
+    counting = false;
+    return {allocationCount.load(), allocatedBytes.load()};
+}
@@ -0,0 +1,153 @@
+#include "clip_opener.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <stdexcept>
+
+#include "helper.hpp"
+
+sakurajin::PendingTile::PendingTile ( const std::string& _filename ) : filename{_filename}, cancelled{std::make_shared<std::atomic<bool>>(false)} {}
+
+const std::string& sakurajin::PendingTile::getFilename() const {
+    return filename;
+}
+
+const std::string& sakurajin::PendingTile::getError() const {
+    return error;
+}
+
+void sakurajin::PendingTile::collect() {
+    try{
+        tiles = result.get();
+        state = tiles.empty() ? State::cancelled : State::ready;
+    }catch(const std::exception& e){
+        Helper::print_exception(e);
+        error = e.what();
+        state = State::failed;
+    }
+}
+
+sakurajin::PendingTile::State sakurajin::PendingTile::poll() {
+    if(state == State::opening && result.wait_for(std::chrono::seconds{0}) == std::future_status::ready){
+        collect();
+    }
+    return state;
+}
+
+sakurajin::PendingTile::State sakurajin::PendingTile::wait() {
+    if(state == State::opening){
+        collect();
+    }
+    return state;
+}
+
+void sakurajin::PendingTile::cancel() {
+    //the flag stays with the readers of a finished tile, so only an open that still runs is stopped
+    if(poll() != State::opening){
+        for(auto& tile : takeAll()){
+            opener->close(std::move(tile));
+        }
+        if(state == State::ready){
+            state = State::cancelled;
+        }
+        return;
+    }
+    *cancelled = true;
+
+    //the unfinished job keeps its own reference to the result and drops the tile itself
+    state = State::cancelled;
+    result = {};
+}
+
+std::unique_ptr<sakurajin::VideoTile> sakurajin::PendingTile::take() {
+    auto opened = takeAll();
+    if(opened.empty()){
+        return nullptr;
+    }
+
+    for(size_t i = 1; i < opened.size(); i++){
+        opener->close(std::move(opened[i]));
+    }
+    return std::move(opened.front());
+}
+
+std::vector<std::unique_ptr<sakurajin::VideoTile>> sakurajin::PendingTile::takeAll() {
+    return std::move(tiles);
+}
+
+sakurajin::ClipOpener::ClipOpener ( const MediaResources& _resources, unsigned int threadCount ) : resources{_resources} {
+    pool = std::make_unique<WorkerPool>(threadCount);
+    closePool = std::make_unique<WorkerPool>(1);
+}
+
+sakurajin::ClipOpener::~ClipOpener() {
+    for(auto& flag : running){
+        if(auto cancelled = flag.lock()){
+            *cancelled = true;
+        }
+    }
+    pool.reset();
+    closePool.reset();
+}
+
+std::shared_ptr<sakurajin::PendingTile> sakurajin::ClipOpener::open ( const std::string& filename, bool reverse, bool allStreams ) {
+    auto pending = std::make_shared<PendingTile>(filename);
+    pending->opener = this;
+
+    running.erase(std::remove_if(running.begin(), running.end(), [](const auto& flag){
+        return flag.expired();
+    }), running.end());
+    running.emplace_back(pending->cancelled);
+
+    //the readers of the tile stop as soon as the handle is cancelled
+    auto tileResources = resources;
+    tileResources.cancelled = pending->cancelled;
+
+    //reverse playback seeks, which a shared demuxer can't do
+    const bool shareDemuxer = allStreams && !reverse;
+
+    pending->result = pool->submit([tileResources, filename, reverse, shareDemuxer, cancelled = pending->cancelled]() -> std::vector<std::unique_ptr<VideoTile>> {
+        std::vector<std::unique_ptr<VideoTile>> opened;
+        if(*cancelled){
+            return opened;
+        }
+
+        try{
+            if(shareDemuxer){
+                auto demuxer = std::make_shared<StreamDemuxer>(filename, tileResources);
+                for(size_t i = 0; i < demuxer->getVideoStreamCount() && !*cancelled; i++){
+                    opened.emplace_back(std::make_unique<VideoTile>(demuxer, static_cast<int>(i), tileResources));
+                }
+            }else{
+                opened.emplace_back(std::make_unique<VideoTile>(filename, tileResources, reverse));
+            }
+
+            for(auto& tile : opened){
+                tile->prepare();
+            }
+        }catch(...){
+            if(*cancelled){
+                return {};
+            }
+            std::throw_with_nested(std::runtime_error("could not open " + filename));
+        }
+
+        //tiles that were cancelled after they opened are closed right here
+        if(*cancelled){
+            return {};
+        }
+        return opened;
+    });
+
+    return pending;
+}
+
+void sakurajin::ClipOpener::close ( std::unique_ptr<VideoTile> tile ) {
+    if(!tile){
+        return;
+    }
+
+    closePool->submit([closed = std::move(tile)]() mutable {
+        closed.reset();
+    });
+}
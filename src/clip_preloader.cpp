@@ -0,0 +1,214 @@
+#include "clip_preloader.hpp"
+
+#include <algorithm>
+#include <cerrno>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace{
+    //large reads keep the disk busy, small enough that cancelling is quick
+    constexpr size_t loadChunkSize = 4 * 1024 * 1024;
+}
+
+sakurajin::PreloadedClip::PreloadedClip ( const std::string& _filename, size_t _size ) : filename{_filename}, size{_size} {
+    //the data is not initialized, it is overwritten by the load anyway
+    data.reset(new uint8_t[size]);
+}
+
+void sakurajin::PreloadedClip::setState ( State _state ) {
+    {
+        std::scoped_lock lock{stateMutex};
+        state = _state;
+    }
+    stateChanged.notify_all();
+}
+
+const std::string& sakurajin::PreloadedClip::getFilename() const {
+    return filename;
+}
+
+size_t sakurajin::PreloadedClip::getSize() const {
+    return size;
+}
+
+sakurajin::PreloadedClip::State sakurajin::PreloadedClip::getState() const {
+    std::scoped_lock lock{stateMutex};
+    return state;
+}
+
+size_t sakurajin::PreloadedClip::getLoadedBytes() const {
+    return loadedBytes;
+}
+
+float sakurajin::PreloadedClip::getProgress() const {
+    return size > 0 ? static_cast<float>(loadedBytes) / static_cast<float>(size) : 1.0f;
+}
+
+bool sakurajin::PreloadedClip::wait() const {
+    std::unique_lock lock{stateMutex};
+    stateChanged.wait(lock, [this](){ return state != State::loading; });
+    return state == State::ready;
+}
+
+bool sakurajin::PreloadedClip::waitFor ( std::chrono::milliseconds timeout ) const {
+    std::unique_lock lock{stateMutex};
+    return stateChanged.wait_for(lock, timeout, [this](){ return state != State::loading; });
+}
+
+const uint8_t* sakurajin::PreloadedClip::getData() const {
+    return data.get();
+}
+
+sakurajin::ClipPreloader::ClipPreloader() : ClipPreloader{Config{}} {}
+
+sakurajin::ClipPreloader::ClipPreloader ( const Config& _config ) : config{_config} {
+    pool = std::make_unique<WorkerPool>(std::max(config.threads, 1u));
+}
+
+sakurajin::ClipPreloader::~ClipPreloader() {
+    //the running loads stop at the next chunk, the waiting ones right away
+    {
+        std::scoped_lock lock{clipMutex};
+        for(auto& clip : clips){
+            clip->cancelled = true;
+        }
+    }
+    pool.reset();
+}
+
+void sakurajin::ClipPreloader::load ( PreloadedClip& clip ) {
+    int fd = open(clip.filename.c_str(), O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        clip.setState(PreloadedClip::State::failed);
+        return;
+    }
+
+    //the whole file is read once from start to end
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    size_t offset = 0;
+    while(offset < clip.size){
+        if(clip.cancelled){
+            close(fd);
+            clip.setState(PreloadedClip::State::failed);
+            return;
+        }
+
+        ssize_t count = pread(fd, clip.data.get() + offset, std::min(loadChunkSize, clip.size - offset), offset);
+        if(count < 0 && errno == EINTR){
+            continue;
+        }
+        if(count <= 0){
+            close(fd);
+            clip.setState(PreloadedClip::State::failed);
+            return;
+        }
+
+        offset += count;
+        clip.loadedBytes = offset;
+    }
+
+    //the data is in memory now, the page cache copy isn't needed for playback anymore
+    posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+    close(fd);
+    clip.setState(PreloadedClip::State::ready);
+}
+
+bool sakurajin::ClipPreloader::makeRoom ( size_t size ) {
+    //only the preloader holds the clips that no reader uses, those can be dropped
+    for(auto i = clips.begin(); i != clips.end() && reservedBytes + size > config.memoryBudget;){
+        if(i->use_count() == 1){
+            reservedBytes -= (*i)->size;
+            i = clips.erase(i);
+        }else{
+            i++;
+        }
+    }
+
+    return reservedBytes + size <= config.memoryBudget;
+}
+
+std::shared_ptr<sakurajin::PreloadedClip> sakurajin::ClipPreloader::preload ( const std::string& filename ) {
+    std::scoped_lock lock{clipMutex};
+
+    //a clip that is requested again moves to the back, so it is dropped last
+    auto existing = std::find_if(clips.begin(), clips.end(), [&filename](const auto& clip){
+        return clip->filename == filename;
+    });
+    if(existing != clips.end()){
+        auto clip = *existing;
+        if(clip->getState() != PreloadedClip::State::failed){
+            clips.erase(existing);
+            clips.emplace_back(clip);
+            return clip;
+        }
+
+        //a failed load is tried again
+        reservedBytes -= clip->size;
+        clips.erase(existing);
+    }
+
+    struct stat fileStat;
+    if(stat(filename.c_str(), &fileStat) != 0 || !S_ISREG(fileStat.st_mode)){
+        return nullptr;
+    }
+
+    const size_t size = fileStat.st_size;
+    if(size == 0 || size > config.maxClipSize || !makeRoom(size)){
+        return nullptr;
+    }
+
+    std::shared_ptr<PreloadedClip> clip;
+    try{
+        clip = std::make_shared<PreloadedClip>(filename, size);
+    }catch(const std::bad_alloc&){
+        return nullptr;
+    }
+
+    clips.emplace_back(clip);
+    reservedBytes += size;
+
+    //the job only holds the clip while it runs, so a dropped clip can be freed
+    pool->submit([clip](){
+        load(*clip);
+    });
+
+    return clip;
+}
+
+void sakurajin::ClipPreloader::release ( const std::string& filename ) {
+    std::scoped_lock lock{clipMutex};
+
+    auto clip = std::find_if(clips.begin(), clips.end(), [&filename](const auto& entry){
+        return entry->filename == filename;
+    });
+    if(clip == clips.end()){
+        return;
+    }
+
+    //a reader still plays it, the clip is dropped later once the budget needs the room
+    if((*clip)->getState() != PreloadedClip::State::loading && clip->use_count() > 1){
+        return;
+    }
+
+    //the load job holds the clip until it sees the cancellation
+    (*clip)->cancelled = true;
+    reservedBytes -= (*clip)->size;
+    clips.erase(clip);
+}
+
+std::vector<std::shared_ptr<sakurajin::PreloadedClip>> sakurajin::ClipPreloader::getClips() const {
+    std::scoped_lock lock{clipMutex};
+    return clips;
+}
+
+size_t sakurajin::ClipPreloader::getReservedBytes() const {
+    std::scoped_lock lock{clipMutex};
+    return reservedBytes;
+}
+
+const sakurajin::ClipPreloader::Config& sakurajin::ClipPreloader::getConfig() const {
+    return config;
+}
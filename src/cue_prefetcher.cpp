@@ -0,0 +1,170 @@
+#include "cue_prefetcher.hpp"
+
+#include <algorithm>
+#include <fstream>
+#include <stdexcept>
+
+sakurajin::CuePrefetcher::CuePrefetcher ( const MediaResources& _resources, std::vector<Cue> _cues ) : CuePrefetcher{_resources, std::move(_cues), Config{}} {}
+
+sakurajin::CuePrefetcher::CuePrefetcher ( const MediaResources& _resources, std::vector<Cue> _cues, const Config& _config ) : resources{_resources}, config{_config} {
+    cues.reserve(_cues.size());
+    for(auto& cue : _cues){
+        Slot slot;
+        slot.cue = std::move(cue);
+        cues.emplace_back(std::move(slot));
+    }
+
+    opener = std::make_unique<ClipOpener>(resources, std::max(config.threads, 1u));
+    schedule();
+}
+
+sakurajin::CuePrefetcher::~CuePrefetcher() {
+    for(auto& slot : cues){
+        if(slot.pending){
+            slot.pending->cancel();
+        }
+    }
+
+    //the warm tiles are closed before the opener stops
+    cues.clear();
+    opener.reset();
+}
+
+std::vector<sakurajin::CuePrefetcher::Cue> sakurajin::CuePrefetcher::loadCueList ( const std::string& filename, bool reverse ) {
+    std::ifstream file{filename};
+    if(!file){
+        throw std::runtime_error("could not open the cue list " + filename);
+    }
+
+    std::vector<Cue> cueList;
+    std::string line;
+    while(std::getline(file, line)){
+        if(line.empty() || line[0] == '#'){
+            continue;
+        }
+        cueList.push_back({line, reverse});
+    }
+
+    return cueList;
+}
+
+void sakurajin::CuePrefetcher::collect ( Slot& slot ) {
+    if(slot.state != CueState::warming){
+        return;
+    }
+
+    auto state = slot.pending->poll();
+    if(state == PendingTile::State::opening){
+        return;
+    }
+
+    slot.state = state == PendingTile::State::ready ? CueState::warm : CueState::failed;
+}
+
+void sakurajin::CuePrefetcher::cancel ( Slot& slot, CueState state ) {
+    //an unfinished warm up drops its tile on the opener thread once it sees the cancellation,
+    //a warm tile is closed in the background
+    if(slot.pending){
+        slot.pending->cancel();
+        slot.pending.reset();
+    }
+    slot.state = state;
+
+    //the preloaded data goes as well, unless another upcoming cue plays the same clip
+    if(!resources.preloader){
+        return;
+    }
+    for(size_t i = nextCue; i < cues.size() && i < nextCue + config.lookahead; i++){
+        if(&cues[i] != &slot && cues[i].cue.filename == slot.cue.filename){
+            return;
+        }
+    }
+    resources.preloader->release(slot.cue.filename);
+}
+
+void sakurajin::CuePrefetcher::schedule() {
+    const size_t end = std::min(cues.size(), nextCue + config.lookahead);
+    for(size_t i = nextCue; i < end; i++){
+        auto& slot = cues[i];
+        if(slot.state != CueState::cold){
+            continue;
+        }
+
+        slot.state = CueState::warming;
+
+        //the preload starts right away, the decoder threads only open one cue at a time
+        if(resources.preloader){
+            resources.preloader->preload(slot.cue.filename);
+        }
+        slot.pending = opener->open(slot.cue.filename, slot.cue.reverse);
+    }
+}
+
+void sakurajin::CuePrefetcher::update() {
+    for(size_t i = nextCue; i < cues.size() && i < nextCue + config.lookahead; i++){
+        collect(cues[i]);
+    }
+}
+
+std::shared_ptr<sakurajin::PendingTile> sakurajin::CuePrefetcher::fire() {
+    while(nextCue < cues.size()){
+        auto& slot = cues[nextCue++];
+
+        //a cue outside of the lookahead is late, it starts warming now and is handed over anyway
+        if(slot.state == CueState::cold){
+            slot.state = CueState::warming;
+            slot.pending = opener->open(slot.cue.filename, slot.cue.reverse);
+        }
+        collect(slot);
+
+        //a cue that can't be played is passed over
+        if(slot.state == CueState::failed){
+            slot.pending.reset();
+            continue;
+        }
+
+        slot.state = CueState::played;
+        schedule();
+        return std::move(slot.pending);
+    }
+
+    return nullptr;
+}
+
+void sakurajin::CuePrefetcher::skip() {
+    if(nextCue >= cues.size()){
+        return;
+    }
+
+    auto& slot = cues[nextCue++];
+    cancel(slot, CueState::skipped);
+    schedule();
+}
+
+size_t sakurajin::CuePrefetcher::getCueCount() const {
+    return cues.size();
+}
+
+size_t sakurajin::CuePrefetcher::getNextCue() const {
+    return nextCue;
+}
+
+const sakurajin::CuePrefetcher::Cue& sakurajin::CuePrefetcher::getCue ( size_t cue ) const {
+    return cues.at(cue).cue;
+}
+
+sakurajin::CuePrefetcher::CueState sakurajin::CuePrefetcher::getCueState ( size_t cue ) const {
+    return cues.at(cue).state;
+}
+
+const char* sakurajin::CuePrefetcher::getStateName ( CueState state ) {
+    switch(state){
+        case CueState::cold: return "cold";
+        case CueState::warming: return "warming";
+        case CueState::warm: return "warm";
+        case CueState::failed: return "failed";
+        case CueState::played: return "played";
+        case CueState::skipped: return "skipped";
+    }
+    return "unknown";
+}
@@ -0,0 +1,26 @@
+#include "embedded_shaders.hpp"
+
+std::optional<std::string_view> sakurajin::EmbeddedShaders::find ( const std::filesystem::path& location ) {
+    auto name = location.lexically_normal().generic_string();
+    for(size_t i = 0; i < fileCount; i++){
+        if(files[i].location == name){
+            return files[i].content;
+        }
+    }
+    return std::nullopt;
+}
+
+bool sakurajin::EmbeddedShaders::allowsOverride() {
+#if defined(SAKURAJIN_SHADER_OVERRIDE) && SAKURAJIN_SHADER_OVERRIDE
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool sakurajin::EmbeddedShaders::exists ( const std::filesystem::path& location ) {
+    if(allowsOverride() && std::filesystem::exists(location)){
+        return true;
+    }
+    return find(location).has_value();
+}
@@ -0,0 +1,202 @@
+#include "frame_memory_pool.hpp"
+
+#include <algorithm>
+#include <cstdlib>
+#include <new>
+
+#include <sys/mman.h>
+
+namespace{
+    size_t alignUp(size_t size, size_t alignment){
+        return (size + alignment - 1) & ~(alignment - 1);
+    }
+
+    bool isPowerOfTwo(size_t value){
+        return value != 0 && (value & (value - 1)) == 0;
+    }
+}
+
+sakurajin::FrameMemoryPool::FrameMemoryPool() : FrameMemoryPool{Config{}} {}
+
+sakurajin::FrameMemoryPool::FrameMemoryPool ( const Config& config ) : state{std::make_shared<State>()} {
+    //mapped buffers are only page aligned
+    if(!isPowerOfTwo(config.alignment) || config.alignment < sizeof(void*) || config.alignment > 4096){
+        throw std::invalid_argument("the frame memory alignment has to be a power of two of at most 4096");
+    }
+
+    state->config = config;
+}
+
+sakurajin::FrameMemoryPool::State::~State() {
+    for(auto& [sizeClass, allocations] : freeLists){
+        for(auto& allocation : allocations){
+            free(allocation);
+        }
+    }
+    for(auto handle : freeHandles){
+        ::operator delete(handle);
+    }
+}
+
+sakurajin::FrameMemoryPool::Allocation sakurajin::FrameMemoryPool::State::allocate ( size_t size ) {
+    //only buffers of at least one huge page can use them, smaller ones stay on the heap
+    if(config.hugePages != HugePages::none && size >= hugePageSize){
+        const size_t mappedSize = alignUp(size, hugePageSize);
+        if(config.hugePages == HugePages::reserved){
+            void* data = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+            if(data != MAP_FAILED){
+                return {data, mappedSize, true, true};
+            }
+        }
+
+        void* data = mmap(nullptr, mappedSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if(data == MAP_FAILED){
+            throw std::bad_alloc();
+        }
+
+        //without THP support this fails and the mapping simply uses normal pages
+        const bool advised = madvise(data, mappedSize, MADV_HUGEPAGE) == 0;
+        return {data, mappedSize, true, advised};
+    }
+
+    void* data = nullptr;
+    if(posix_memalign(&data, config.alignment, size) != 0){
+        throw std::bad_alloc();
+    }
+    return {data, size, false, false};
+}
+
+void sakurajin::FrameMemoryPool::State::free ( const Allocation& allocation ) {
+    if(allocation.mapped){
+        munmap(allocation.data, allocation.size);
+    }else{
+        std::free(allocation.data);
+    }
+}
+
+void sakurajin::FrameMemoryPool::State::release ( Allocation allocation ) {
+    {
+        std::scoped_lock lock{mutex};
+        stats.bytesInUse -= allocation.size;
+
+        if(stats.bytesCached + allocation.size <= config.maxCachedBytes){
+            stats.bytesCached += allocation.size;
+            freeLists[allocation.size].emplace_back(allocation);
+            return;
+        }
+
+        stats.systemFrees++;
+        if(allocation.hugePages){
+            stats.hugePageBytes -= allocation.size;
+        }
+    }
+
+    //unmapping can be slow, so it is done without holding the lock
+    free(allocation);
+}
+
+void* sakurajin::FrameMemoryPool::State::acquireHandle() {
+    {
+        std::scoped_lock lock{mutex};
+        if(!freeHandles.empty()){
+            auto handle = freeHandles.back();
+            freeHandles.pop_back();
+            return handle;
+        }
+        stats.handleAllocations++;
+    }
+
+    return ::operator new(handleSize);
+}
+
+void sakurajin::FrameMemoryPool::State::releaseHandle ( void* handle ) {
+    std::scoped_lock lock{mutex};
+    freeHandles.emplace_back(handle);
+}
+
+size_t sakurajin::FrameMemoryPool::getSizeClass ( size_t size ) const {
+    size = std::max<size_t>(size, 4096);
+
+    //sizes in (2^(n-1), 2^n] are rounded to a multiple of 2^(n-3),
+    //which gives four classes per power of two and wastes less than 25%
+    size_t bits = 0;
+    while((size - 1) >> bits){
+        bits++;
+    }
+    const size_t step = size_t{1} << (bits - 3);
+
+    size_t sizeClass = alignUp(size, step);
+    if(state->config.hugePages != HugePages::none && sizeClass >= hugePageSize){
+        sizeClass = alignUp(sizeClass, hugePageSize);
+    }
+    return alignUp(sizeClass, state->config.alignment);
+}
+
+sakurajin::FrameMemory sakurajin::FrameMemoryPool::acquire ( size_t size ) {
+    const size_t sizeClass = getSizeClass(size);
+
+    std::unique_lock lock{state->mutex};
+    auto& stats = state->stats;
+    stats.acquires++;
+
+    Allocation allocation;
+    auto freeList = state->freeLists.find(sizeClass);
+    if(freeList != state->freeLists.end() && !freeList->second.empty()){
+        allocation = freeList->second.back();
+        freeList->second.pop_back();
+        stats.reuses++;
+        stats.bytesCached -= allocation.size;
+    }else{
+        //allocating can be slow, so it is done without holding the lock
+        lock.unlock();
+        allocation = state->allocate(sizeClass);
+        lock.lock();
+        stats.systemAllocations++;
+        if(allocation.hugePages){
+            stats.hugePageBytes += allocation.size;
+        }
+    }
+
+    stats.bytesInUse += allocation.size;
+    stats.peakBytesInUse = std::max(stats.peakBytesInUse, stats.bytesInUse);
+    lock.unlock();
+
+    //the allocator in the control block keeps the state alive while the deleter runs.
+    //If no control block can be allocated the deleter returns the buffer right away.
+    return FrameMemory{static_cast<uint8_t*>(allocation.data), [owner = state.get(), allocation](uint8_t*){
+        owner->release(allocation);
+    }, HandleAllocator<uint8_t>{state}};
+}
+
+void sakurajin::FrameMemoryPool::trim() {
+    decltype(state->freeLists) freeLists;
+    {
+        std::scoped_lock lock{state->mutex};
+        std::swap(freeLists, state->freeLists);
+
+        for(auto& [sizeClass, allocations] : freeLists){
+            for(auto& allocation : allocations){
+                state->stats.systemFrees++;
+                if(allocation.hugePages){
+                    state->stats.hugePageBytes -= allocation.size;
+                }
+            }
+        }
+        state->stats.bytesCached = 0;
+    }
+
+    for(auto& [sizeClass, allocations] : freeLists){
+        for(auto& allocation : allocations){
+            state->free(allocation);
+        }
+    }
+}
+
+const sakurajin::FrameMemoryPool::Config& sakurajin::FrameMemoryPool::getConfig() const {
+    return state->config;
+}
+
+sakurajin::FrameMemoryPool::Stats sakurajin::FrameMemoryPool::getStats() const {
+    std::scoped_lock lock{state->mutex};
+    return state->stats;
+}
@@ -0,0 +1,196 @@
+#include "framebuffer_pool.hpp"
+
+#include <algorithm>
+
+namespace{
+    //sizes are rounded up to this, so small resizes stay within one allocation
+    constexpr int sizeGranularity = 128;
+
+    //a target is replaced by a smaller one if less than half of it was used for this many frames
+    constexpr int shrinkDelay = 60;
+
+    //unused targets are kept this many frames before they are freed
+    constexpr uint64_t releaseDelay = 120;
+}
+
+sakurajin::Framebuffer::Framebuffer ( int _width, int _height, GLenum _format ) : width{_width}, height{_height}, format{_format}, usedWidth{_width}, usedHeight{_height} {
+    //create the framebuffer for the output image
+    glGenFramebuffers(1, &FBO);
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+
+    glGenTextures(1, &texture);
+    glBindTexture(GL_TEXTURE_2D, texture);
+    glTexStorage2D(GL_TEXTURE_2D, 1, format, width, height);
+
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+
+    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
+
+    unsigned int DrawBuffers[1] = {GL_COLOR_ATTACHMENT0};
+    glDrawBuffers(1, DrawBuffers);
+
+    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE){
+        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+        glDeleteFramebuffers(1, &FBO);
+        glDeleteTextures(1, &texture);
+        throw std::runtime_error("Could not create framebuffer");
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+sakurajin::Framebuffer::~Framebuffer() {
+    glDeleteFramebuffers(1, &FBO);
+    glDeleteTextures(1, &texture);
+}
+
+void sakurajin::Framebuffer::bind() {
+    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
+    glViewport(0, 0, usedWidth, usedHeight);
+}
+
+void sakurajin::Framebuffer::clear ( float r, float g, float b, float a ) {
+    //only clear the used area, the rest of the texture is never shown
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(0, 0, usedWidth, usedHeight);
+    glClearColor(r, g, b, a);
+    glClear(GL_COLOR_BUFFER_BIT);
+    glDisable(GL_SCISSOR_TEST);
+}
+
+unsigned int sakurajin::Framebuffer::getTexture() const {
+    return texture;
+}
+
+int sakurajin::Framebuffer::getWidth() const {
+    return width;
+}
+
+int sakurajin::Framebuffer::getHeight() const {
+    return height;
+}
+
+GLenum sakurajin::Framebuffer::getFormat() const {
+    return format;
+}
+
+int sakurajin::Framebuffer::getUsedWidth() const {
+    return usedWidth;
+}
+
+int sakurajin::Framebuffer::getUsedHeight() const {
+    return usedHeight;
+}
+
+size_t sakurajin::Framebuffer::getByteSize() const {
+    //all used formats have at most 4 bytes per pixel except the float ones
+    size_t bytesPerPixel = 4;
+    if(format == GL_RGBA16F){
+        bytesPerPixel = 8;
+    }else if(format == GL_RGBA32F){
+        bytesPerPixel = 16;
+    }
+    return static_cast<size_t>(width) * height * bytesPerPixel;
+}
+
+ImVec2 sakurajin::Framebuffer::getUsedUV() const {
+    return ImVec2(
+        static_cast<float>(usedWidth) / width,
+        static_cast<float>(usedHeight) / height
+    );
+}
+
+int sakurajin::FramebufferPool::roundSize ( int size ) {
+    size = std::max(size, 1);
+    return (size + sizeGranularity - 1) / sizeGranularity * sizeGranularity;
+}
+
+std::shared_ptr<sakurajin::Framebuffer> sakurajin::FramebufferPool::acquire ( int width, int height, GLenum format ) {
+    width = std::max(width, 1);
+    height = std::max(height, 1);
+
+    //reuse the smallest free target that fits without wasting more than half of it
+    std::shared_ptr<Framebuffer> best;
+    for(const auto& framebuffer : framebuffers){
+        if(framebuffer.use_count() > 1 || framebuffer->format != format){
+            continue;
+        }
+        if(framebuffer->width < width || framebuffer->height < height){
+            continue;
+        }
+        if(static_cast<size_t>(framebuffer->width) * framebuffer->height > static_cast<size_t>(width) * height * 2){
+            continue;
+        }
+        if(!best || framebuffer->getByteSize() < best->getByteSize()){
+            best = framebuffer;
+        }
+    }
+
+    if(!best){
+        best = std::make_shared<Framebuffer>(roundSize(width), roundSize(height), format);
+        framebuffers.emplace_back(best);
+    }
+
+    best->usedWidth = width;
+    best->usedHeight = height;
+    best->oversizedFrames = 0;
+    best->lastUsedFrame = currentFrame;
+
+    return best;
+}
+
+void sakurajin::FramebufferPool::resize ( std::shared_ptr<Framebuffer>& target, int width, int height, GLenum format ) {
+    width = std::max(width, 1);
+    height = std::max(height, 1);
+
+    if(target && target->format == format && width <= target->width && height <= target->height){
+        //count how long the target has been far too large
+        if(static_cast<size_t>(width) * height * 2 < static_cast<size_t>(target->width) * target->height){
+            target->oversizedFrames++;
+        }else{
+            target->oversizedFrames = 0;
+        }
+
+        if(target->oversizedFrames < shrinkDelay){
+            target->usedWidth = width;
+            target->usedHeight = height;
+            target->lastUsedFrame = currentFrame;
+            return;
+        }
+    }
+
+    //the old target goes back into the pool and is freed later if nothing else needs it
+    target.reset();
+    target = acquire(width, height, format);
+}
+
+void sakurajin::FramebufferPool::endFrame() {
+    currentFrame++;
+
+    //the pool holds the only reference to unused targets
+    framebuffers.erase(
+        std::remove_if(framebuffers.begin(), framebuffers.end(), [this](const std::shared_ptr<Framebuffer>& framebuffer){
+            if(framebuffer.use_count() > 1){
+                framebuffer->lastUsedFrame = currentFrame;
+                return false;
+            }
+            return currentFrame - framebuffer->lastUsedFrame > releaseDelay;
+        }),
+        framebuffers.end()
+    );
+}
+
+size_t sakurajin::FramebufferPool::getTargetCount() const {
+    return framebuffers.size();
+}
+
+size_t sakurajin::FramebufferPool::getAllocatedBytes() const {
+    size_t bytes = 0;
+    for(const auto& framebuffer : framebuffers){
+        bytes += framebuffer->getByteSize();
+    }
+    return bytes;
+}
@@ -0,0 +1,200 @@
+#include "gop_decoder.hpp"
+
+#include <algorithm>
+#include <limits>
+
+sakurajin::GopDecoder::GopDecoder ( const std::string& _filename, const MediaResources& _resources, Direction _direction, unsigned int threadCount, size_t _memoryBudget ) : filename{_filename}, direction{_direction}, resources{_resources}, memoryBudget{_memoryBudget} {
+    //the first reader is used to build the keyframe index and becomes a decoder afterwards
+    preloadedClip = resources.loadClip(filename);
+    auto indexReader = std::make_unique<VideoReaderState>();
+    resources.configureReader(indexReader.get(), preloadedClip.get());
+    if(!video_reader_open(indexReader.get(), filename.c_str())){
+        throw std::runtime_error("could not open video file for GOP decoding");
+    }
+
+    if(!video_reader_build_keyframe_index(indexReader.get())){
+        video_reader_close(indexReader.get());
+        throw std::runtime_error("could not build the keyframe index");
+    }
+
+    keyframes = indexReader->keyframe_index;
+    width = indexReader->width;
+    height = indexReader->height;
+    time_base = indexReader->time_base;
+
+    idleReaders.emplace_back(indexReader.get());
+    readers.emplace_back(std::move(indexReader));
+
+    pool = std::make_unique<WorkerPool>(threadCount);
+
+    //keep every worker busy while the oldest GOP is being played, as far as the memory budget allows
+    maxGopsInFlight = pool->size() + 1;
+    submitGops();
+}
+
+sakurajin::GopDecoder::~GopDecoder() {
+    //stop the running jobs early and wait for all workers before the readers are closed
+    cancelled = true;
+    pool.reset();
+
+    for(auto& reader : readers){
+        video_reader_close(reader.get());
+    }
+}
+
+int sakurajin::GopDecoder::getWidth() const {
+    return width;
+}
+
+int sakurajin::GopDecoder::getHeight() const {
+    return height;
+}
+
+AVRational sakurajin::GopDecoder::getTimeBase() const {
+    return time_base;
+}
+
+size_t sakurajin::GopDecoder::getGopCount() const {
+    return keyframes.size();
+}
+
+void sakurajin::GopDecoder::setReferenceOnly ( bool _referenceOnly ) {
+    referenceOnly = _referenceOnly;
+}
+
+VideoReaderState* sakurajin::GopDecoder::acquireReader() {
+    {
+        std::scoped_lock lock{readerMutex};
+        if(!idleReaders.empty()){
+            auto reader = idleReaders.back();
+            idleReaders.pop_back();
+            return reader;
+        }
+    }
+
+    //opening is slow, so it is done without holding the lock
+    auto reader = std::make_unique<VideoReaderState>();
+    resources.configureReader(reader.get(), preloadedClip.get());
+    if(!video_reader_open(reader.get(), filename.c_str())){
+        video_reader_close(reader.get());
+        throw std::runtime_error("could not open an additional decoder instance");
+    }
+
+    std::scoped_lock lock{readerMutex};
+    readers.emplace_back(std::move(reader));
+    return readers.back().get();
+}
+
+void sakurajin::GopDecoder::releaseReader ( VideoReaderState* reader ) {
+    std::scoped_lock lock{readerMutex};
+    idleReaders.emplace_back(reader);
+}
+
+double sakurajin::GopDecoder::getGopSeconds ( size_t gop ) const {
+    //the last GOP has no end in the index, it is assumed to be as long as the one before
+    if(gop + 1 < keyframes.size()){
+        return (keyframes[gop + 1] - keyframes[gop]) * av_q2d(time_base);
+    }
+    if(gop > 0){
+        return getGopSeconds(gop - 1);
+    }
+    return 1.0;
+}
+
+size_t sakurajin::GopDecoder::gopAtPosition ( size_t position ) const {
+    if(direction == Direction::reverse){
+        return keyframes.size() - 1 - position;
+    }
+    return position;
+}
+
+sakurajin::GopDecoder::DecodedGop sakurajin::GopDecoder::decodeGop ( size_t gop ) {
+    DecodedGop decoded;
+
+    const int64_t start_pts = keyframes[gop];
+    const int64_t end_pts = gop + 1 < keyframes.size() ? keyframes[gop + 1] : std::numeric_limits<int64_t>::max();
+    const size_t frameSize = static_cast<size_t>(width) * height * 4;
+
+    auto reader = acquireReader();
+    video_reader_set_reference_only(reader, referenceOnly);
+    bool success = video_reader_decode_gop(reader, start_pts, end_pts, [&](int64_t pts){
+        if(cancelled){
+            return false;
+        }
+
+        auto data = resources.frameMemory.acquire(frameSize);
+        if(!video_reader_convert_frame(reader, data.get())){
+            return false;
+        }
+
+        decoded.push_back({pts, std::move(data)});
+        return true;
+    });
+    releaseReader(reader);
+
+    if(!success && !cancelled){
+        throw std::runtime_error("could not decode GOP " + std::to_string(gop));
+    }
+
+    //the decoder returns frames in presentation order, reverse playback needs them backwards
+    if(direction == Direction::reverse){
+        std::reverse(decoded.begin(), decoded.end());
+    }
+
+    return decoded;
+}
+
+void sakurajin::GopDecoder::submitGops() {
+    while(pendingGops.size() < maxGopsInFlight && nextSubmitPosition < keyframes.size()){
+        auto gop = gopAtPosition(nextSubmitPosition);
+        const double seconds = std::max(getGopSeconds(gop), 0.0);
+        const size_t estimatedBytes = static_cast<size_t>(seconds * bytesPerSecond);
+
+        //the next GOP is always decoded, the ones after it only if they fit the budget
+        if(!pendingGops.empty() && (bytesPerSecond <= 0.0 || bytesInFlight + estimatedBytes > memoryBudget)){
+            break;
+        }
+
+        nextSubmitPosition++;
+        bytesInFlight += estimatedBytes;
+        pendingGops.push_back({pool->submit([this, gop](){
+            return decodeGop(gop);
+        }), estimatedBytes, seconds});
+    }
+}
+
+bool sakurajin::GopDecoder::nextFrame ( FrameMemory& frame_data, int64_t& pts ) {
+    //GOPs can be empty if all of their frames were dropped, so skip until one has frames
+    while(currentFrame >= currentGop.size()){
+        if(pendingGops.empty()){
+            return false;
+        }
+
+        auto nextGop = std::move(pendingGops.front());
+        pendingGops.pop_front();
+        bytesInFlight -= nextGop.estimatedBytes;
+
+        try{
+            currentGop = nextGop.frames.get();
+        }catch(...){
+            std::throw_with_nested(std::runtime_error("GOP decoding failed"));
+        }
+        currentFrame = 0;
+
+        //the actual size replaces the estimate and teaches the data rate for the next estimates
+        bytesInFlight -= currentGopBytes;
+        currentGopBytes = currentGop.size() * static_cast<size_t>(width) * height * 4;
+        bytesInFlight += currentGopBytes;
+        if(nextGop.seconds > 0.0){
+            bytesPerSecond = std::max(bytesPerSecond, currentGopBytes / nextGop.seconds);
+        }
+
+        submitGops();
+    }
+
+    frame_data = currentGop[currentFrame].data;
+    pts = currentGop[currentFrame].pts;
+    currentFrame++;
+
+    return true;
+}
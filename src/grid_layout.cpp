@@ -0,0 +1,49 @@
+#include "grid_layout.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+sakurajin::GridLayout::GridLayout ( size_t tileCount ) {
+    tileCount = std::max<size_t>(tileCount, 1);
+    columns = static_cast<unsigned int>(std::ceil(std::sqrt(static_cast<double>(tileCount))));
+    rows = static_cast<unsigned int>((tileCount + columns - 1) / columns);
+}
+
+sakurajin::GridLayout::GridLayout ( unsigned int _columns, unsigned int _rows ) : columns{std::max(_columns, 1u)}, rows{std::max(_rows, 1u)} {}
+
+unsigned int sakurajin::GridLayout::getColumns() const {
+    return columns;
+}
+
+unsigned int sakurajin::GridLayout::getRows() const {
+    return rows;
+}
+
+size_t sakurajin::GridLayout::getTileCount() const {
+    return static_cast<size_t>(columns) * rows;
+}
+
+sakurajin::TileRect sakurajin::GridLayout::getTileRect ( size_t index, float outputWidth, float outputHeight, float aspectRatio ) const {
+    const float cellWidth = outputWidth / columns;
+    const float cellHeight = outputHeight / rows;
+    const float cellX = (index % columns) * cellWidth;
+    const float cellY = (index / columns) * cellHeight;
+
+    TileRect rect;
+    rect.width = cellWidth;
+    rect.height = cellHeight;
+
+    //letterbox or pillarbox the video inside the cell
+    if(aspectRatio > 0.0f){
+        if(cellWidth / cellHeight > aspectRatio){
+            rect.width = cellHeight * aspectRatio;
+        }else{
+            rect.height = cellWidth / aspectRatio;
+        }
+    }
+
+    rect.x = cellX + (cellWidth - rect.width) / 2.0f;
+    rect.y = cellY + (cellHeight - rect.height) / 2.0f;
+
+    return rect;
+}
@@ -0,0 +1,498 @@
+#include "grid_renderer.hpp"
+
+#include <algorithm>
+#include <cstddef>
+
+sakurajin::GridRenderer::GridRenderer() {
+    //the chroma arrays of YUV420P are half the size of the luma array in both directions
+    planeFormats[rgbaPlane] = {0, GL_RGBA8, GL_RGBA, 4};
+    planeFormats[lumaPlane] = {0, GL_R8, GL_RED, 1};
+    planeFormats[chromaUPlane] = {0, GL_R8, GL_RED, 1};
+    planeFormats[chromaVPlane] = {0, GL_R8, GL_RED, 1};
+    planeFormats[chromaUVPlane] = {0, GL_RG8, GL_RG, 2};
+
+    //one unit quad that is moved into place by the per-instance rectangle
+    float vertices[] = {
+        // positions
+        1.0f, 1.0f, // top right
+        1.0f, 0.0f, // bottom right
+        0.0f, 0.0f, // bottom left
+        0.0f, 1.0f  // top left
+    };
+    unsigned int indices[] = {
+        0, 1, 3, // first triangle
+        1, 2, 3  // second triangle
+    };
+
+    glGenVertexArrays(1, &VAO);
+    glGenBuffers(1, &VBO);
+    glGenBuffers(1, &EBO);
+    glGenBuffers(1, &instanceVBO);
+
+    glBindVertexArray(VAO);
+
+    glBindBuffer(GL_ARRAY_BUFFER, VBO);
+    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
+
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
+
+    // position attribute
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 2 * sizeof(float), (void*)0);
+    glEnableVertexAttribArray(0);
+
+    // per-instance attributes: tile rectangle, texture area and layer
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(TileInstance), (void*)offsetof(TileInstance, rect));
+    glEnableVertexAttribArray(1);
+    glVertexAttribDivisor(1, 1);
+    glVertexAttribPointer(2, 4, GL_FLOAT, GL_FALSE, sizeof(TileInstance), (void*)offsetof(TileInstance, uv));
+    glEnableVertexAttribArray(2);
+    glVertexAttribDivisor(2, 1);
+    glVertexAttribPointer(3, 1, GL_FLOAT, GL_FALSE, sizeof(TileInstance), (void*)offsetof(TileInstance, layer));
+    glEnableVertexAttribArray(3);
+    glVertexAttribDivisor(3, 1);
+    glVertexAttribPointer(4, 3, GL_FLOAT, GL_FALSE, sizeof(TileInstance), (void*)offsetof(TileInstance, grade));
+    glEnableVertexAttribArray(4);
+    glVertexAttribDivisor(4, 1);
+
+    glBindVertexArray(0);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+sakurajin::GridRenderer::~GridRenderer() {
+    glDeleteVertexArrays(1, &VAO);
+    glDeleteBuffers(1, &VBO);
+    glDeleteBuffers(1, &EBO);
+    glDeleteBuffers(1, &instanceVBO);
+    for(auto& layerClass : layerClasses){
+        for(auto& array : layerClass.arrays){
+            glDeleteTextures(1, &array.texture);
+        }
+    }
+}
+
+int sakurajin::GridRenderer::getClassSize ( int size ) {
+    //the classes are 2^n and 1.5 * 2^n, so a layer is at most 1.5 times the frame size in each
+    //direction. Every class size is even, so the chroma layers are exactly half of it.
+    int step = 64;
+    while(true){
+        if(size <= step){
+            return step;
+        }
+        if(size <= step + step / 2){
+            return step + step / 2;
+        }
+        step *= 2;
+    }
+}
+
+void sakurajin::GridRenderer::allocateTextureArray ( LayerArray& array, int width, int height, int layers ) {
+    //immutable storage can't be resized, so the old array is replaced
+    glDeleteTextures(1, &array.texture);
+
+    glGenTextures(1, &array.texture);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, 1, array.internalFormat, width, height, layers);
+
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+
+    array.width = width;
+    array.height = height;
+    array.layers = layers;
+
+    //the texture areas depend on the layer size
+    instancesDirty = true;
+}
+
+void sakurajin::GridRenderer::setTileCount ( size_t count ) {
+    if(count == tiles.size()){
+        return;
+    }
+
+    //the layers of removed tiles can be taken by other frames of their class
+    for(size_t i = count; i < tiles.size(); i++){
+        releaseLayer(tiles[i]);
+    }
+
+    //new tiles show their own layers, a source that was removed falls back to that as well
+    const size_t previousCount = tiles.size();
+    tiles.resize(count);
+    for(size_t i = 0; i < count; i++){
+        if(i >= previousCount || tiles[i].source >= count){
+            tiles[i].source = i;
+        }
+    }
+    instancesDirty = true;
+}
+
+size_t sakurajin::GridRenderer::getTileCount() const {
+    return tiles.size();
+}
+
+bool sakurajin::GridRenderer::setTileRect ( size_t tile, const TileRect& rect, bool visible ) {
+    auto& state = tiles.at(tile);
+    if(
+        state.visible == visible &&
+        state.rect.x == rect.x &&
+        state.rect.y == rect.y &&
+        state.rect.width == rect.width &&
+        state.rect.height == rect.height
+    ){
+        return false;
+    }
+
+    state.rect = rect;
+    state.visible = visible;
+    instancesDirty = true;
+    return true;
+}
+
+void sakurajin::GridRenderer::setTileVariant ( size_t tile, uint32_t variant ) {
+    auto& state = tiles.at(tile);
+    if(state.variant == variant){
+        return;
+    }
+
+    state.variant = variant;
+    instancesDirty = true;
+}
+
+bool sakurajin::GridRenderer::setTileGrade ( size_t tile, const TileGrade& grade ) {
+    auto& state = tiles.at(tile);
+    if(
+        state.grade.enabled == grade.enabled &&
+        state.grade.brightness == grade.brightness &&
+        state.grade.contrast == grade.contrast &&
+        state.grade.saturation == grade.saturation
+    ){
+        return false;
+    }
+
+    state.grade = grade;
+    instancesDirty = true;
+    return true;
+}
+
+void sakurajin::GridRenderer::setTileSource ( size_t tile, size_t source ) {
+    auto& state = tiles.at(tile);
+    if(source >= tiles.size() || state.source == source){
+        return;
+    }
+
+    state.source = source;
+    instancesDirty = true;
+}
+
+bool sakurajin::GridRenderer::reserveArray ( LayerClass& layerClass, Plane plane ) {
+    auto& array = layerClass.arrays[plane];
+    const int layers = layerClass.usedLayers.size();
+    if(array.texture != 0 && array.layers >= layers){
+        return false;
+    }
+
+    //a new array only has to be filled by the frame that needs it, replacing one
+    //discards the layers of every tile in the class
+    const bool discarded = array.texture != 0;
+    const bool chroma = plane != rgbaPlane && plane != lumaPlane;
+    allocateTextureArray(
+        array,
+        chroma ? layerClass.width / 2 : layerClass.width,
+        chroma ? layerClass.height / 2 : layerClass.height,
+        layers
+    );
+
+    return discarded;
+}
+
+bool sakurajin::GridRenderer::acquireLayer ( TileState& state, int width, int height ) {
+    //reuse the class of that size or the slot of a class that isn't used anymore
+    size_t index = noLayerClass;
+    for(size_t i = 0; i < layerClasses.size(); i++){
+        if(layerClasses[i].width == width && layerClasses[i].height == height){
+            index = i;
+            break;
+        }
+        if(index == noLayerClass && layerClasses[i].width == 0){
+            index = i;
+        }
+    }
+    if(index == noLayerClass){
+        index = layerClasses.size();
+        layerClasses.emplace_back();
+    }
+
+    auto& layerClass = layerClasses[index];
+    if(layerClass.width != width || layerClass.height != height){
+        layerClass.width = width;
+        layerClass.height = height;
+        std::copy(std::begin(planeFormats), std::end(planeFormats), std::begin(layerClass.arrays));
+        layerClass.usedLayers.clear();
+    }
+
+    state.layerClass = index;
+    instancesDirty = true;
+
+    auto freeLayer = std::find(layerClass.usedLayers.begin(), layerClass.usedLayers.end(), false);
+    if(freeLayer != layerClass.usedLayers.end()){
+        *freeLayer = true;
+        state.layer = freeLayer - layerClass.usedLayers.begin();
+        return false;
+    }
+
+    //the layer count doubles, so a class that fills up is only reallocated a few times
+    state.layer = layerClass.usedLayers.size();
+    const size_t layers = std::max<size_t>(layerClass.usedLayers.size() * 2, 1);
+    layerClass.usedLayers.resize(std::min(layers, std::max<size_t>(tiles.size(), 1)), false);
+    layerClass.usedLayers[state.layer] = true;
+
+    bool reallocated = false;
+    for(int plane = 0; plane < planeCount; plane++){
+        if(layerClass.arrays[plane].texture != 0){
+            reallocated |= reserveArray(layerClass, static_cast<Plane>(plane));
+        }
+    }
+    return reallocated;
+}
+
+void sakurajin::GridRenderer::releaseLayer ( TileState& state ) {
+    if(state.layerClass == noLayerClass){
+        return;
+    }
+
+    auto& layerClass = layerClasses[state.layerClass];
+    layerClass.usedLayers[state.layer] = false;
+    state.layerClass = noLayerClass;
+    state.layer = 0;
+    instancesDirty = true;
+
+    //a class without frames gives its memory back, the slot is reused by the next new size
+    if(std::find(layerClass.usedLayers.begin(), layerClass.usedLayers.end(), true) == layerClass.usedLayers.end()){
+        for(auto& array : layerClass.arrays){
+            glDeleteTextures(1, &array.texture);
+        }
+        layerClass = LayerClass{};
+    }
+}
+
+bool sakurajin::GridRenderer::reserveLayers ( size_t tile, const FrameView& frame ) {
+    auto& state = tiles.at(tile);
+    if(!frame.isValid()){
+        return false;
+    }
+
+    //the class is picked by the luma size, which is kept even for the chroma layers
+    const int width = getClassSize(frame.width);
+    const int height = getClassSize(frame.height);
+
+    bool reallocated = false;
+    if(state.layerClass == noLayerClass || layerClasses[state.layerClass].width != width || layerClasses[state.layerClass].height != height){
+        releaseLayer(state);
+        reallocated = acquireLayer(state, width, height);
+    }
+
+    auto& layerClass = layerClasses[state.layerClass];
+    switch(frame.format){
+        case PixelFormat::rgba:
+            reallocated |= reserveArray(layerClass, rgbaPlane);
+            break;
+        case PixelFormat::yuv420p:
+            reallocated |= reserveArray(layerClass, lumaPlane);
+            reallocated |= reserveArray(layerClass, chromaUPlane);
+            reallocated |= reserveArray(layerClass, chromaVPlane);
+            break;
+        case PixelFormat::nv12:
+            reallocated |= reserveArray(layerClass, lumaPlane);
+            reallocated |= reserveArray(layerClass, chromaUVPlane);
+            break;
+    }
+
+    return reallocated;
+}
+
+void sakurajin::GridRenderer::uploadPlane ( const LayerArray& array, int layer, const uint8_t* data, int linesize, int width, int height ) {
+    //the decoder rows are padded, the row length skips the padding during the upload
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, linesize / array.bytesPerPixel);
+    glTexSubImage3D(GL_TEXTURE_2D_ARRAY, 0, 0, 0, layer, width, height, 1, array.pixelFormat, GL_UNSIGNED_BYTE, data);
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+}
+
+void sakurajin::GridRenderer::uploadTile ( size_t tile, const FrameView& frame ) {
+    auto& state = tiles.at(tile);
+    if(!frame.isValid()){
+        return;
+    }
+
+    reserveLayers(tile, frame);
+
+    const auto& arrays = layerClasses[state.layerClass].arrays;
+    const int chromaWidth = (frame.width + 1) / 2;
+    const int chromaHeight = (frame.height + 1) / 2;
+    switch(frame.format){
+        case PixelFormat::rgba:
+            uploadPlane(arrays[rgbaPlane], state.layer, frame.planes[0], frame.linesizes[0], frame.width, frame.height);
+            break;
+        case PixelFormat::yuv420p:
+            uploadPlane(arrays[lumaPlane], state.layer, frame.planes[0], frame.linesizes[0], frame.width, frame.height);
+            uploadPlane(arrays[chromaUPlane], state.layer, frame.planes[1], frame.linesizes[1], chromaWidth, chromaHeight);
+            uploadPlane(arrays[chromaVPlane], state.layer, frame.planes[2], frame.linesizes[2], chromaWidth, chromaHeight);
+            break;
+        case PixelFormat::nv12:
+            uploadPlane(arrays[lumaPlane], state.layer, frame.planes[0], frame.linesizes[0], frame.width, frame.height);
+            uploadPlane(arrays[chromaUVPlane], state.layer, frame.planes[1], frame.linesizes[1], chromaWidth, chromaHeight);
+            break;
+    }
+
+    //a different LOD or format only changes the used texture area
+    if(state.frameWidth != frame.width || state.frameHeight != frame.height || state.format != frame.format){
+        state.frameWidth = frame.width;
+        state.frameHeight = frame.height;
+        state.format = frame.format;
+        instancesDirty = true;
+    }
+}
+
+void sakurajin::GridRenderer::updateInstances() {
+    //group the visible tiles by variant and class, so each group needs only one draw call
+    std::vector<size_t> visibleTiles;
+    for(size_t i = 0; i < tiles.size(); i++){
+        const auto& state = tiles[i];
+        const auto& frame = tiles[state.source];
+        if(state.visible && frame.layerClass != noLayerClass && frame.frameWidth > 0 && frame.frameHeight > 0){
+            visibleTiles.emplace_back(i);
+        }
+    }
+    std::stable_sort(visibleTiles.begin(), visibleTiles.end(), [this](size_t a, size_t b){
+        if(tiles[a].variant != tiles[b].variant){
+            return tiles[a].variant < tiles[b].variant;
+        }
+        return tiles[tiles[a].source].layerClass < tiles[tiles[b].source].layerClass;
+    });
+
+    std::vector<TileInstance> instances;
+    instances.reserve(visibleTiles.size());
+    instanceGroups.clear();
+
+    for(auto i : visibleTiles){
+        const auto& state = tiles[i];
+        const auto& frame = tiles[state.source];
+        if(instanceGroups.empty() || instanceGroups.back().variant != state.variant || instanceGroups.back().layerClass != frame.layerClass){
+            instanceGroups.push_back({state.variant, frame.layerClass, instances.size(), 0});
+        }
+        instanceGroups.back().count++;
+
+        //sample half a texel inside the used area so the rest of the layer never bleeds in
+        const auto& layerClass = layerClasses[frame.layerClass];
+        TileInstance instance{
+            {state.rect.x, state.rect.y, state.rect.width, state.rect.height},
+            {
+                0.5f / layerClass.width,
+                0.5f / layerClass.height,
+                (frame.frameWidth - 0.5f) / layerClass.width,
+                (frame.frameHeight - 0.5f) / layerClass.height
+            },
+            static_cast<float>(frame.layer),
+            {state.grade.brightness, state.grade.contrast, state.grade.saturation}
+        };
+        instances.emplace_back(instance);
+    }
+
+    glBindBuffer(GL_ARRAY_BUFFER, instanceVBO);
+    if(instances.size() > instanceCapacity){
+        instanceCapacity = std::max(instances.size(), tiles.size());
+        glBufferData(GL_ARRAY_BUFFER, instanceCapacity * sizeof(TileInstance), NULL, GL_DYNAMIC_DRAW);
+    }
+    glBufferSubData(GL_ARRAY_BUFFER, 0, instances.size() * sizeof(TileInstance), instances.data());
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+    instanceCount = instances.size();
+    instancesDirty = false;
+}
+
+bool sakurajin::GridRenderer::draw ( ShaderVariants& variants ) {
+    if(instancesDirty){
+        updateInstances();
+    }
+
+    if(instanceCount == 0){
+        return true;
+    }
+
+    bool complete = true;
+    glBindVertexArray(VAO);
+    for(const auto& group : instanceGroups){
+        auto shader = variants.get(group.variant);
+        if(!shader->isReady()){
+            complete = false;
+            continue;
+        }
+
+        //the units match the samplers of the tile shader: Tex, TexU or TexUV, TexV
+        const auto& arrays = layerClasses[group.layerClass].arrays;
+        switch(ShaderVariantKey::unpack(group.variant).pixelFormat){
+            case PixelFormat::rgba:
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[rgbaPlane].texture);
+                break;
+            case PixelFormat::yuv420p:
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[lumaPlane].texture);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[chromaUPlane].texture);
+                glActiveTexture(GL_TEXTURE2);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[chromaVPlane].texture);
+                break;
+            case PixelFormat::nv12:
+                glActiveTexture(GL_TEXTURE0);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[lumaPlane].texture);
+                glActiveTexture(GL_TEXTURE1);
+                glBindTexture(GL_TEXTURE_2D_ARRAY, arrays[chromaUVPlane].texture);
+                break;
+        }
+        glActiveTexture(GL_TEXTURE0);
+
+        shader->use();
+        glDrawElementsInstancedBaseInstance(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0, group.count, group.first);
+    }
+    glBindVertexArray(0);
+
+    return complete;
+}
+
+int sakurajin::GridRenderer::getLayerWidth() const {
+    int width = 0;
+    for(const auto& layerClass : layerClasses){
+        width = std::max(width, layerClass.width);
+    }
+    return width;
+}
+
+int sakurajin::GridRenderer::getLayerHeight() const {
+    int height = 0;
+    for(const auto& layerClass : layerClasses){
+        height = std::max(height, layerClass.height);
+    }
+    return height;
+}
+
+size_t sakurajin::GridRenderer::getLayerClassCount() const {
+    size_t count = 0;
+    for(const auto& layerClass : layerClasses){
+        if(layerClass.width > 0){
+            count++;
+        }
+    }
+    return count;
+}
+
+size_t sakurajin::GridRenderer::getDrawCallCount() const {
+    return instanceGroups.size();
+}
+
+size_t sakurajin::GridRenderer::getVisibleTileCount() const {
+    return instanceCount;
+}
@@ -77,60 +77,20 @@ void sakurajin::imguiHandler::endRender_impl() {
     SDL_GL_SwapWindow(window);
 }
 
-void sakurajin::imguiHandler::initFramebuffer_impl ( unsigned int& FBO, unsigned int& texture, uint64_t width, uint64_t height ) {
-    //create the framebuffer for the output image
-    glGenFramebuffers(1, &FBO);
-    glBindFramebuffer(GL_FRAMEBUFFER, FBO);
-    
-    glGenTextures(1, &texture);
-    glBindTexture(GL_TEXTURE_2D, texture);
-
-    glTexImage2D(
-        GL_TEXTURE_2D,
-        0,
-        GL_RGBA,
-        width,
-        height,
-        0,
-        GL_RGBA,
-        GL_UNSIGNED_BYTE,
-        NULL
-    );
-
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, texture, 0);
-    
-    unsigned int DrawBuffers[1] = {GL_COLOR_ATTACHMENT0};
-    glDrawBuffers(1, DrawBuffers);
-    
-    if(glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE){
-        throw std::runtime_error("Could not create output framebuffer");
-    }
-    
-    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+void sakurajin::imguiHandler::updateRenderThread_impl() {
+    SDL_GL_MakeCurrent(window, gl_context);
 }
 
-void sakurajin::imguiHandler::loadFramebuffer_impl ( unsigned int buf, uint64_t width, uint64_t height ) {
-        
-    glBindFramebuffer(GL_FRAMEBUFFER, buf);
-    glViewport(0, 0, width, height);
 
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_CULL_FACE);
-        
-    glEnable(GL_BLEND);
-    //glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
-    //glBlendEquation(GL_MAX);
-    
-    glClearColor(0.7f, 0.7f, 0.0f, 0.0f);
-    glClear(GL_COLOR_BUFFER_BIT);
+bool sakurajin::imguiHandler::isMinimized_impl() {
+    auto flags = SDL_GetWindowFlags(window);
+    return flags & (SDL_WINDOW_MINIMIZED | SDL_WINDOW_HIDDEN);
 }
 
-void sakurajin::imguiHandler::updateRenderThread_impl() {
-    SDL_GL_MakeCurrent(window, gl_context);
+int sakurajin::imguiHandler::getRefreshRate_impl() {
+    SDL_DisplayMode mode;
+    if(SDL_GetCurrentDisplayMode(SDL_GetWindowDisplayIndex(window), &mode) != 0 || mode.refresh_rate <= 0){
+        return 60;
+    }
+    return mode.refresh_rate;
 }
-
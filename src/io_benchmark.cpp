@@ -0,0 +1,119 @@
+#include "io_benchmark.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <stdexcept>
+
+#include "helper.hpp"
+#include "io_scheduler.hpp"
+#include "video_reader.hpp"
+#include "worker_pool.hpp"
+
+sakurajin::IoBenchmark::Result sakurajin::IoBenchmark::run ( const std::vector<std::string>& files, size_t readerCount, Input input ) {
+    if(files.empty() || readerCount == 0){
+        throw std::invalid_argument("the IO benchmark needs at least one clip and one reader");
+    }
+
+    std::unique_ptr<IoScheduler> scheduler;
+    if(input == Input::scheduled){
+        scheduler = std::make_unique<IoScheduler>();
+    }
+
+    //opening is not part of the measurement, only demuxing is
+    std::vector<std::unique_ptr<VideoReaderState>> readers;
+    for(size_t i = 0; i < readerCount; i++){
+        auto reader = std::make_unique<VideoReaderState>();
+        reader->use_mmap = input == Input::memoryMapped;
+        reader->io_scheduler = scheduler.get();
+        const auto& file = files[i % files.size()];
+        if(!video_reader_open(reader.get(), file.c_str())){
+            video_reader_close(reader.get());
+            for(auto& opened : readers){
+                video_reader_close(opened.get());
+            }
+            throw std::runtime_error("could not open " + file + " for the IO benchmark");
+        }
+        readers.emplace_back(std::move(reader));
+    }
+
+    Result result;
+    result.readers = readerCount;
+    for(const auto& reader : readers){
+        if(video_reader_is_mapped(reader.get()) || reader->io_stream){
+            result.customInputReaders++;
+        }
+    }
+
+    struct ReaderResult{
+        bool success = false;
+        uint64_t packets = 0;
+        uint64_t bytes = 0;
+    };
+
+    bool success = true;
+    auto start = std::chrono::steady_clock::now();
+    {
+        //one thread per reader, so every reader is demuxing at the same time
+        WorkerPool pool{static_cast<unsigned int>(readerCount)};
+        std::vector<std::future<ReaderResult>> jobs;
+        for(auto& reader : readers){
+            jobs.emplace_back(pool.submit([state = reader.get()](){
+                ReaderResult readerResult;
+                readerResult.success = video_reader_demux_to_end(state, &readerResult.packets, &readerResult.bytes);
+                return readerResult;
+            }));
+        }
+
+        for(auto& job : jobs){
+            auto readerResult = job.get();
+            success = success && readerResult.success;
+            result.packets += readerResult.packets;
+            result.bytes += readerResult.bytes;
+        }
+    }
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    for(auto& reader : readers){
+        video_reader_close(reader.get());
+    }
+
+    if(scheduler){
+        auto stats = scheduler->getStats();
+        result.peakQueueDepth = stats.peakQueueDepth;
+        result.stalls = stats.stalls;
+    }
+
+    if(!success){
+        throw std::runtime_error("a reader of the IO benchmark failed to demux its clip");
+    }
+
+    return result;
+}
+
+bool sakurajin::IoBenchmark::runComparison ( const std::vector<std::string>& files, size_t readerCount ) {
+    try{
+        //the first run warms the page cache, so both measured runs start from the same state
+        run(files, readerCount, Input::fileProtocol);
+
+        auto print = [](const char* name, const Result& result){
+            printf("%-16s %zu readers (%zu custom input): %lu packets, %.1f MiB in %.3fs, %.1f MiB/s\n",
+                name, result.readers, result.customInputReaders, result.packets,
+                result.bytes / (1024.0 * 1024.0), result.seconds,
+                result.bytes / (1024.0 * 1024.0) / result.seconds
+            );
+        };
+
+        print("file protocol", run(files, readerCount, Input::fileProtocol));
+        print("memory mapped", run(files, readerCount, Input::memoryMapped));
+
+        auto scheduled = run(files, readerCount, Input::scheduled);
+        print("scheduled", scheduled);
+        printf("%-16s peak queue depth %u, %lu stalled reads\n", "", scheduled.peakQueueDepth, scheduled.stalls);
+    }catch(const std::exception& e){
+        Helper::print_exception(e);
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,428 @@
+#include "io_scheduler.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+extern "C" {
+#include <libavformat/avformat.h>
+}
+
+namespace{
+    //direct IO needs buffers, offsets and sizes aligned to the logical block size
+    constexpr size_t bufferAlignment = 4096;
+}
+
+//the descriptor is shared with the running reads, so closing a stream never pulls it away from one
+struct sakurajin::IoStream::File{
+    int fd;
+
+    explicit File(int _fd) : fd{_fd} {}
+    File(const File&) = delete;
+    File& operator=(const File&) = delete;
+
+    ~File(){
+        close(fd);
+    }
+};
+
+struct sakurajin::IoStream::Block{
+    enum class State{
+        queued,
+        reading,
+        ready,
+        failed
+    };
+
+    IoScheduler& scheduler;
+    std::shared_ptr<File> file;
+    int64_t offset;
+    size_t expectedSize;
+    size_t size = 0;
+    uint8_t* data;
+    State state = State::queued;
+    int error = 0;
+
+    Block(IoScheduler& _scheduler, std::shared_ptr<File> _file, int64_t _offset, size_t _expectedSize) :
+        scheduler{_scheduler}, file{std::move(_file)}, offset{_offset}, expectedSize{_expectedSize}, data{scheduler.acquireBuffer()} {}
+
+    ~Block(){
+        scheduler.releaseBuffer(data);
+    }
+};
+
+sakurajin::IoStream::IoStream ( IoScheduler& _scheduler, std::shared_ptr<File> _file, int64_t _fileSize ) : scheduler{_scheduler}, file{std::move(_file)}, fileSize{_fileSize} {
+    //until the bitrate is known a few blocks are read ahead
+    readahead = scheduler.config.blockSize * 4;
+}
+
+int sakurajin::IoStream::read ( uint8_t* buffer, int size ) {
+    std::shared_ptr<Block> block;
+    {
+        std::unique_lock lock{scheduler.mutex};
+        if(position >= fileSize){
+            return AVERROR_EOF;
+        }
+
+        scheduler.scheduleWindow(*this);
+
+        const int64_t blockOffset = position - position % scheduler.config.blockSize;
+        block = blocks.at(blockOffset);
+        if(block->state != Block::State::ready && block->state != Block::State::failed){
+            //the waiting stream goes first, so its block is moved to the front of the queue
+            scheduler.stats.stalls++;
+            waiting = true;
+            scheduler.submitQueued();
+            scheduler.blockDone.wait(lock, [&block](){
+                return block->state == Block::State::ready || block->state == Block::State::failed;
+            });
+            waiting = false;
+        }
+
+        if(block->state == Block::State::failed){
+            return block->error;
+        }
+    }
+
+    //the data of a finished block doesn't change anymore, so it is copied without the lock
+    const size_t blockPosition = position - block->offset;
+    const size_t count = std::min<size_t>(size, block->size - blockPosition);
+    memcpy(buffer, block->data + blockPosition, count);
+    position += count;
+
+    return static_cast<int>(count);
+}
+
+int64_t sakurajin::IoStream::seek ( int64_t offset, int whence ) {
+    std::scoped_lock lock{scheduler.mutex};
+
+    int64_t target;
+    switch(whence & ~AVSEEK_FORCE){
+        case AVSEEK_SIZE: return fileSize;
+        case SEEK_SET: target = offset; break;
+        case SEEK_CUR: target = position + offset; break;
+        case SEEK_END: target = fileSize + offset; break;
+        default: return AVERROR(EINVAL);
+    }
+    if(target < 0 || target > fileSize){
+        return AVERROR(EINVAL);
+    }
+
+    //the window moves with the next read
+    position = target;
+    return position;
+}
+
+void sakurajin::IoStream::setBitrate ( int64_t bitrate ) {
+    if(bitrate <= 0){
+        return;
+    }
+
+    const auto& config = scheduler.config;
+    const double bytes = bitrate / 8.0 * config.readaheadSeconds;
+    const size_t blockSize = config.blockSize;
+
+    size_t size = std::clamp<size_t>(static_cast<size_t>(bytes), blockSize * 2, std::max(config.maxReadahead, blockSize * 2));
+    size = (size + blockSize - 1) / blockSize * blockSize;
+
+    std::scoped_lock lock{scheduler.mutex};
+    readahead = size;
+}
+
+int64_t sakurajin::IoStream::getFileSize() const {
+    return fileSize;
+}
+
+sakurajin::IoScheduler::IoScheduler() : IoScheduler{Config{}} {}
+
+sakurajin::IoScheduler::IoScheduler ( const Config& _config ) : config{_config} {
+    if(config.blockSize == 0 || config.blockSize % bufferAlignment != 0){
+        throw std::invalid_argument("the IO block size has to be a multiple of 4096");
+    }
+    config.queueDepth = std::max(config.queueDepth, 1u);
+    lastStatsTime = std::chrono::steady_clock::now();
+
+#if defined(SAKURAJIN_IO_URING) && SAKURAJIN_IO_URING
+    //the ring is left for the thread pool if the kernel doesn't support it or it is blocked
+    if(io_uring_queue_init(config.queueDepth, &ring, 0) == 0){
+        ioUring = true;
+        completionThread = std::thread{&IoScheduler::completionLoop, this};
+    }
+#endif
+
+    if(!ioUring){
+        fallbackPool = std::make_unique<WorkerPool>(config.fallbackThreads);
+    }
+}
+
+sakurajin::IoScheduler::~IoScheduler() {
+    {
+        std::scoped_lock lock{mutex};
+        stopping = true;
+
+        //the queued reads are dropped, the running ones still finish
+        streams.clear();
+    }
+
+#if defined(SAKURAJIN_IO_URING) && SAKURAJIN_IO_URING
+    if(ioUring){
+        //an empty request wakes up the completion thread, so it can see that it has to stop
+        {
+            std::scoped_lock lock{mutex};
+            auto sqe = io_uring_get_sqe(&ring);
+            if(sqe){
+                io_uring_prep_nop(sqe);
+                io_uring_sqe_set_data(sqe, nullptr);
+                io_uring_submit(&ring);
+            }
+        }
+        completionThread.join();
+        io_uring_queue_exit(&ring);
+    }
+#endif
+
+    //waits for the running reads
+    fallbackPool.reset();
+
+    for(auto buffer : freeBuffers){
+        free(buffer);
+    }
+}
+
+uint8_t* sakurajin::IoScheduler::acquireBuffer() {
+    {
+        std::scoped_lock lock{bufferMutex};
+        if(!freeBuffers.empty()){
+            auto buffer = freeBuffers.back();
+            freeBuffers.pop_back();
+            return buffer;
+        }
+    }
+
+    void* buffer = nullptr;
+    if(posix_memalign(&buffer, bufferAlignment, config.blockSize) != 0){
+        throw std::bad_alloc();
+    }
+    return static_cast<uint8_t*>(buffer);
+}
+
+void sakurajin::IoScheduler::releaseBuffer ( uint8_t* buffer ) {
+    std::scoped_lock lock{bufferMutex};
+    freeBuffers.emplace_back(buffer);
+}
+
+void sakurajin::IoScheduler::scheduleWindow ( IoStream& stream ) {
+    const int64_t blockSize = config.blockSize;
+    const int64_t first = stream.position - stream.position % blockSize;
+    const int64_t end = std::min<int64_t>(stream.position + stream.readahead, stream.fileSize);
+
+    //blocks outside of the window are dropped, a running read keeps its block alive until it is done
+    for(auto i = stream.blocks.begin(); i != stream.blocks.end();){
+        if(i->first < first || i->first >= end){
+            i = stream.blocks.erase(i);
+        }else{
+            i++;
+        }
+    }
+
+    bool queued = false;
+    for(int64_t offset = first; offset < end; offset += blockSize){
+        if(stream.blocks.count(offset) != 0){
+            continue;
+        }
+
+        const size_t expectedSize = std::min<int64_t>(blockSize, stream.fileSize - offset);
+        stream.blocks.emplace(offset, std::make_shared<IoStream::Block>(*this, stream.file, offset, expectedSize));
+        queued = true;
+    }
+
+    if(queued){
+        submitQueued();
+    }
+}
+
+void sakurajin::IoScheduler::submitQueued() {
+    while(!stopping && inFlight.size() < config.queueDepth){
+        //a waiting stream goes first, then the one with the least data ahead of its reader
+        std::shared_ptr<IoStream::Block> next;
+        double lowestFill = std::numeric_limits<double>::max();
+
+        for(const auto& stream : streams){
+            std::shared_ptr<IoStream::Block> firstQueued;
+            size_t readyBytes = 0;
+            for(const auto& [offset, block] : stream->blocks){
+                if(block->state == IoStream::Block::State::ready){
+                    readyBytes += block->size;
+                }else if(block->state == IoStream::Block::State::queued && !firstQueued){
+                    firstQueued = block;
+                }
+            }
+            if(!firstQueued){
+                continue;
+            }
+
+            double fill = stream->waiting ? -1.0 : static_cast<double>(readyBytes) / stream->readahead;
+            if(fill < lowestFill){
+                lowestFill = fill;
+                next = firstQueued;
+            }
+        }
+
+        if(!next || !submit(next)){
+            return;
+        }
+    }
+}
+
+bool sakurajin::IoScheduler::submit ( const std::shared_ptr<IoStream::Block>& block ) {
+#if defined(SAKURAJIN_IO_URING) && SAKURAJIN_IO_URING
+    if(ioUring){
+        //the queue depth is the ring size, so this only fails if the ring is in a bad state
+        auto sqe = io_uring_get_sqe(&ring);
+        if(!sqe){
+            return false;
+        }
+
+        //the whole block is requested, a short read only happens at the end of the file
+        io_uring_prep_read(sqe, block->file->fd, block->data, config.blockSize, block->offset);
+        io_uring_sqe_set_data(sqe, block.get());
+        io_uring_submit(&ring);
+    }
+#endif
+
+    block->state = IoStream::Block::State::reading;
+    inFlight.emplace(block.get(), block);
+    stats.queueDepth = inFlight.size();
+    stats.peakQueueDepth = std::max(stats.peakQueueDepth, stats.queueDepth);
+
+    if(!ioUring){
+        fallbackPool->submit([this, block, blockSize = config.blockSize](){
+            ssize_t result = pread(block->file->fd, block->data, blockSize, block->offset);
+            int64_t status = result < 0 ? -errno : result;
+
+            std::scoped_lock lock{mutex};
+            complete(block.get(), status);
+        });
+    }
+
+    return true;
+}
+
+void sakurajin::IoScheduler::complete ( IoStream::Block* block, int64_t result ) {
+    auto entry = inFlight.find(block);
+    if(entry == inFlight.end()){
+        return;
+    }
+
+    //partial reads only happen at the end of the file, anything else is treated as an error
+    if(result < 0){
+        block->state = IoStream::Block::State::failed;
+        block->error = AVERROR(static_cast<int>(-result));
+    }else if(static_cast<size_t>(result) < block->expectedSize){
+        block->state = IoStream::Block::State::failed;
+        block->error = AVERROR(EIO);
+    }else{
+        block->size = block->expectedSize;
+        block->state = IoStream::Block::State::ready;
+        stats.reads++;
+        stats.bytesRead += block->size;
+    }
+
+    inFlight.erase(entry);
+    stats.queueDepth = inFlight.size();
+    blockDone.notify_all();
+
+    submitQueued();
+}
+
+void sakurajin::IoScheduler::completionLoop() {
+#if defined(SAKURAJIN_IO_URING) && SAKURAJIN_IO_URING
+    while(true){
+        io_uring_cqe* cqe = nullptr;
+        int response = io_uring_wait_cqe(&ring, &cqe);
+        if(response == -EINTR){
+            continue;
+        }
+        if(response < 0){
+            return;
+        }
+
+        auto block = static_cast<IoStream::Block*>(io_uring_cqe_get_data(cqe));
+        int64_t result = cqe->res;
+        io_uring_cqe_seen(&ring, cqe);
+
+        std::scoped_lock lock{mutex};
+        if(block){
+            complete(block, result);
+        }
+        if(stopping && inFlight.empty()){
+            return;
+        }
+    }
+#endif
+}
+
+sakurajin::IoStream* sakurajin::IoScheduler::openStream ( const std::string& filename ) {
+    int fd = -1;
+    if(config.directIo){
+        fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC | O_DIRECT);
+    }
+    //not every filesystem supports direct IO, those files use the page cache
+    if(fd < 0){
+        fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+    }
+    if(fd < 0){
+        return nullptr;
+    }
+
+    struct stat fileStat;
+    if(fstat(fd, &fileStat) != 0 || !S_ISREG(fileStat.st_mode)){
+        close(fd);
+        return nullptr;
+    }
+
+    auto file = std::make_shared<IoStream::File>(fd);
+
+    std::scoped_lock lock{mutex};
+    streams.emplace_back(new IoStream{*this, std::move(file), fileStat.st_size});
+    return streams.back().get();
+}
+
+void sakurajin::IoScheduler::closeStream ( IoStream* stream ) {
+    std::scoped_lock lock{mutex};
+    streams.erase(std::remove_if(streams.begin(), streams.end(), [stream](const auto& entry){
+        return entry.get() == stream;
+    }), streams.end());
+}
+
+bool sakurajin::IoScheduler::isUsingIoUring() const {
+    return ioUring;
+}
+
+const sakurajin::IoScheduler::Config& sakurajin::IoScheduler::getConfig() const {
+    return config;
+}
+
+sakurajin::IoScheduler::Stats sakurajin::IoScheduler::getStats() {
+    std::scoped_lock lock{mutex};
+
+    //the throughput is averaged over at least half a second, so it doesn't jump every frame
+    auto now = std::chrono::steady_clock::now();
+    double elapsed = std::chrono::duration<double>(now - lastStatsTime).count();
+    if(elapsed >= 0.5){
+        stats.throughput = (stats.bytesRead - lastBytesRead) / elapsed;
+        lastBytesRead = stats.bytesRead;
+        lastStatsTime = now;
+    }
+
+    stats.ioUring = ioUring;
+    stats.streams = streams.size();
+    return stats;
+}
@@ -1,9 +1,33 @@
 #include <stdio.h>
 #include <stdlib.h>
+#include <algorithm>
 #include <chrono>
+#include <optional>
 #include <thread>
-#include "video_reader.hpp"
-#include "shader.hpp"
+#include <utility>
+#include <string_view>
+#include <string>
+#include <vector>
+#include "video_tile.hpp"
+#include "grid_layout.hpp"
+#include "grid_renderer.hpp"
+#include "framebuffer_pool.hpp"
+#include "frame_memory_pool.hpp"
+#include "allocation_counter.hpp"
+#include "io_benchmark.hpp"
+#include "clip_opener.hpp"
+#include "clip_preloader.hpp"
+#include "cue_prefetcher.hpp"
+#include "io_scheduler.hpp"
+#include "media_resources.hpp"
+#include "packet_pool.hpp"
+#include "output_effects.hpp"
+#include "quality_governor.hpp"
+#include "render_graph.hpp"
+#include "shared_decode.hpp"
+#include "shader_manager.hpp"
+#include "shader_variants.hpp"
+#include "uniform_buffer.hpp"
 
 using namespace std::literals;
 const std::string glsl_version = "#version 460 core";
@@ -12,95 +36,531 @@ uint64_t fboWidth = 1920;
 uint64_t fboHeight = 1080;
 
 int main(int argc, const char** argv) {
+    //parse the command line: [--reverse] [--allocation-check] [--io-benchmark] [--async-io] [--direct-io] [--mmap] [--no-preload] [--setlist <file>] [video files...]
+    std::vector<std::string> video_files;
+    bool reverse_playback = false;
+    bool allocation_check = false;
+    bool io_benchmark = false;
+    bool async_io = false;
+    bool direct_io = false;
+    bool mmap_io = false;
+    bool preload = true;
+    std::string setlist_file;
+    for(int i = 1; i < argc; i++){
+        if(std::string_view{argv[i]} == "--reverse"){
+            reverse_playback = true;
+        }else if(std::string_view{argv[i]} == "--allocation-check"){
+            allocation_check = true;
+        }else if(std::string_view{argv[i]} == "--io-benchmark"){
+            io_benchmark = true;
+        }else if(std::string_view{argv[i]} == "--async-io"){
+            async_io = true;
+        }else if(std::string_view{argv[i]} == "--direct-io"){
+            async_io = true;
+            direct_io = true;
+        }else if(std::string_view{argv[i]} == "--mmap"){
+            mmap_io = true;
+        }else if(std::string_view{argv[i]} == "--no-preload"){
+            preload = false;
+        }else if(std::string_view{argv[i]} == "--setlist" && i + 1 < argc){
+            setlist_file = argv[++i];
+        }else{
+            video_files.emplace_back(argv[i]);
+        }
+    }
+    
+    //a setlist plays its cues one after another in a single tile
+    std::vector<sakurajin::CuePrefetcher::Cue> cue_list;
+    if(!setlist_file.empty()){
+        try{
+            cue_list = sakurajin::CuePrefetcher::loadCueList(setlist_file, reverse_playback);
+        }catch(const std::exception& e){
+            sakurajin::Helper::print_exception(e);
+            return 1;
+        }
+        if(cue_list.empty()){
+            printf("the setlist %s has no cues\n", setlist_file.c_str());
+            return 1;
+        }
+        video_files.clear();
+        for(const auto& cue : cue_list){
+            video_files.emplace_back(cue.filename);
+        }
+    }
+    if(video_files.empty()){
+        video_files.emplace_back("data/example_video.mp4");
+    }
+    
+    //the benchmark demuxes the clips without any window and exits afterwards
+    if(io_benchmark){
+        const size_t io_benchmark_readers = std::max<size_t>(32, video_files.size());
+        return sakurajin::IoBenchmark::runComparison(video_files, io_benchmark_readers) ? 0 : 1;
+    }
+    
+    if(allocation_check && !sakurajin::AllocationCounter::isAvailable()){
+        printf("--allocation-check needs a build with -Dallocation_counter=true\n");
+        return 1;
+    }
+    
     sakurajin::imguiHandler::init();
-    unsigned int FBO = 0, outTexture = 0;
-    sakurajin::imguiHandler::initFramebuffer(FBO,outTexture, fboWidth, fboHeight);
     
-    std::shared_ptr<sakurajin::Shader> outputShader;
+    //the output target follows the size of the output window
+    sakurajin::FramebufferPool framebuffer_pool;
+    std::shared_ptr<sakurajin::Framebuffer> output_target;
+    
+    //all shaders are compiled in the background and reloaded when their files change
+    sakurajin::ShaderManager shader_manager;
+    
+    //the tile shader is specialized for the pixel format and alpha of each video,
+    //the samplers are assigned to the texture units once for every variant
+    sakurajin::ShaderVariants tile_shaders{shader_manager, sakurajin::Shader_configuration{"data/shader.vert","data/shader.frag"}, [](sakurajin::Shader& shader){
+        shader.setUniform("Tex",0);
+        shader.setUniform("TexU",1);
+        shader.setUniform("TexV",2);
+        shader.setUniform("TexUV",1);
+    }};
+    
+    //the projection and output size are shared by all output shaders and only uploaded if they change
+    sakurajin::UniformBuffer frame_uniforms{sizeof(sakurajin::FrameUniforms)};
+    frame_uniforms.bind(sakurajin::FrameUniforms::binding);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    
+    //the CPU side frame buffers of all tiles and decoders are recycled through one pool,
+    //the packets and frames of the readers through another one
+    sakurajin::FrameMemoryPool frame_memory;
+    sakurajin::CuePrefetcher::Config cue_config;
+    const size_t open_readers = cue_list.empty() ? video_files.size() : cue_config.lookahead + 1;
+    sakurajin::PacketPool packet_pool{open_readers, open_readers * 2};
+    
+    //local files are read with read() unless they go through the shared IO scheduler or are mapped
+    std::unique_ptr<sakurajin::IoScheduler> io_scheduler;
+    if(async_io){
+        sakurajin::IoScheduler::Config io_config;
+        io_config.directIo = direct_io;
+        io_scheduler = std::make_unique<sakurajin::IoScheduler>(io_config);
+    }
+    
+    //short clips are loaded into memory, all of them start loading at once before the tiles wait for them.
+    //A setlist only loads the upcoming cues, the prefetcher starts those
+    std::unique_ptr<sakurajin::ClipPreloader> clip_preloader;
+    if(preload){
+        clip_preloader = std::make_unique<sakurajin::ClipPreloader>();
+        if(cue_list.empty()){
+            for(const auto& file : video_files){
+                clip_preloader->preload(file);
+            }
+        }
+    }
+    sakurajin::MediaResources media_resources{frame_memory, packet_pool, io_scheduler.get(), mmap_io, clip_preloader.get(), nullptr};
+    
+    //the videos are opened in the background, their slots show a placeholder until the first frame is decoded
+    sakurajin::ClipOpener clip_opener{media_resources};
+    std::vector<std::shared_ptr<sakurajin::PendingTile>> pending_tiles;
+    
+    //the direction of each opening file and how often it was requested again while opening,
+    //every repeat becomes a mirror of each of its streams once the streams are known
+    struct PendingRequest{
+        bool reverse;
+        int repeats = 0;
+    };
+    std::vector<PendingRequest> pending_requests;
+    
+    //open one tile for every video, or the tile of the first cue
+    std::vector<std::unique_ptr<sakurajin::VideoTile>> tiles;
+    std::unique_ptr<sakurajin::CuePrefetcher> prefetcher;
+    
+    //a clip that is already playing or opening is only decoded once, the other slots mirror its tiles.
+    //Every video stream of a file gets its own tile, the streams are demuxed together.
+    sakurajin::SharedDecode shared_decode;
+    auto open_clip = [&](const std::string& file){
+        sakurajin::SharedDecode::Mirror mirror;
+        mirror.filename = file;
+        mirror.reverse = reverse_playback;
+        
+        for(size_t i = 0; i < pending_tiles.size(); i++){
+            if(pending_tiles[i]->getFilename() == file && pending_requests[i].reverse == reverse_playback){
+                pending_requests[i].repeats++;
+                return;
+            }
+        }
+        
+        bool playing = false;
+        for(const auto& tile : tiles){
+            if(tile->getFilename() == file && tile->isReverse() == reverse_playback){
+                mirror.stream = tile->getStream();
+                shared_decode.addMirror(mirror);
+                playing = true;
+            }
+        }
+        if(!playing){
+            pending_tiles.emplace_back(clip_opener.open(file, reverse_playback, true));
+            pending_requests.push_back({reverse_playback});
+        }
+    };
+    
     try{
-        outputShader = std::make_shared<sakurajin::Shader>("data/shader.vert","data/shader.frag");
+        if(cue_list.empty()){
+            for(const auto& file : video_files){
+                open_clip(file);
+            }
+            
+            //the allocation check needs every tile in its steady state, so it doesn't open anything during the loop
+            if(allocation_check){
+                for(auto& pending : pending_tiles){
+                    pending->wait();
+                }
+            }
+        }else{
+            //nothing is shown yet, so the first cue is waited for
+            prefetcher = std::make_unique<sakurajin::CuePrefetcher>(media_resources, std::move(cue_list), cue_config);
+            while(auto first_cue = prefetcher->fire()){
+                first_cue->wait();
+                if(auto first_tile = first_cue->take()){
+                    tiles.emplace_back(std::move(first_tile));
+                    break;
+                }
+            }
+            if(tiles.empty()){
+                throw std::runtime_error("no cue of the setlist could be opened");
+            }
+        }
     }catch(const std::exception& e){
         sakurajin::Helper::print_exception(e);
-        return -1;
-    }
-    
-    //assign the samplers to the texture units
-    outputShader->setUniform("yTex",0);
-
-    // Generate texture
-    GLuint texRGB;
-    glGenTextures(1, &texRGB);
-    glBindTexture(GL_TEXTURE_2D, texRGB);
-    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-    
-    //init the video renderer
-    VideoReaderState vr_state;
-    if (!video_reader_open(&vr_state, "data/example_video.mp4")) {
         printf("Couldn't open video file (make sure you set a video file that exists)\n");
         return 1;
     }
+    //the mirrors take the slots after the tiles, the placeholders of the opening tiles come last
+    auto get_slot_count = [&](){
+        return tiles.size() + shared_decode.getMirrorCount() + pending_tiles.size();
+    };
+    sakurajin::GridLayout layout{get_slot_count()};
+    
+    //the tiles are drawn with one instanced draw call per shader variant and resolution class
+    sakurajin::GridRenderer renderer;
+    renderer.setTileCount(get_slot_count());
 
-    // Allocate frame buffer
-    constexpr int ALIGNMENT = 128;
-    const int frame_width = vr_state.width;
-    const int frame_height = vr_state.height;
-    uint8_t* frame_data;
-    if (posix_memalign((void**)&frame_data, ALIGNMENT, frame_width * frame_height * 4) != 0) {
-        printf("Couldn't allocate frame buffer\n");
-        return 1;
+    glDisable(GL_DEPTH_TEST);
+    glDisable(GL_CULL_FACE);
+    
+    //the grid and the effects are declared as passes every time the output is redrawn.
+    //The effects of single tiles are applied by the tile shader while the grid is drawn.
+    sakurajin::RenderGraph render_graph;
+    std::unique_ptr<sakurajin::OutputEffects> effects;
+    try{
+        effects = std::make_unique<sakurajin::OutputEffects>(shader_manager);
+    }catch(const std::exception& e){
+        sakurajin::Helper::print_exception(e);
+        return -1;
     }
     
-    //load the vertex buffers to store coordinates
-    unsigned int VAO = 0, EBO = 0, VBO = 0;
-    float vertices[] = {
-        // positions    // texture coords
-         16.0f,  9.0f,  1.0f, 1.0f, // top right
-         16.0f, -9.0f,  1.0f, 0.0f, // bottom right
-        -16.0f, -9.0f,  0.0f, 0.0f, // bottom left
-        -16.0f,  9.0f,  0.0f, 1.0f  // top left 
+    //the controls of the user for each tile
+    struct TileControls{
+        bool shown = true;
+        bool paused = false;
+        int priority = 0;
+        sakurajin::TileGrade grade;
     };
-    unsigned int indices[] = {  
-        0, 1, 3, // first triangle
-        1, 2, 3  // second triangle
+    std::vector<TileControls> tile_controls(tiles.size());
+    
+    //every tile can have a standby tile that replaces it once its first frame is decoded
+    std::vector<std::shared_ptr<sakurajin::PendingTile>> standby_tiles(tiles.size());
+    
+    //degrade low priority tiles if a frame takes longer than one display refresh
+    sakurajin::QualityGovernor governor{1.0 / sakurajin::imguiHandler::getRefreshRate()};
+    //the governor reopens decoders when it changes the quality, which is not the steady state
+    bool governor_enabled = !allocation_check;
+    
+    //the next cue is fired with space or the setlist window, the time until its first frame is uploaded is shown
+    bool fire_requested = false;
+    std::optional<std::chrono::steady_clock::time_point> cue_fire_time;
+    double cue_latency = 0.0;
+    //the cue becomes the standby tile of the first slot, the current tile stays on screen until
+    //the cue is warm. A cue that is fired while the previous one still warms up replaces it.
+    auto fire_cue = [&](){
+        auto start = std::chrono::steady_clock::now();
+        auto next_cue = prefetcher->fire();
+        if(!next_cue){
+            return;
+        }
+        
+        if(standby_tiles[0]){
+            standby_tiles[0]->cancel();
+        }
+        standby_tiles[0] = std::move(next_cue);
+        cue_fire_time = start;
     };
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
-    glGenBuffers(1, &EBO);
-
-    glBindVertexArray(VAO);
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, sizeof(vertices), vertices, GL_STATIC_DRAW);
-
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, EBO);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(indices), indices, GL_STATIC_DRAW);
-    
-    // position attribute
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)0);
-    glEnableVertexAttribArray(0);
-    // texture coord attribute
-    glVertexAttribPointer(1, 2, GL_FLOAT, GL_FALSE, 4 * sizeof(float), (void*)(2 * sizeof(float)));
-    glEnableVertexAttribArray(1);
-
-    glDisable(GL_DEPTH_TEST);
-    glDisable(GL_CULL_FACE);
     
     SDL_Event event;
-    
     bool exit = false;
+    auto poll_events = [&](){
+        while(SDL_PollEvent(&event)){
+            ImGui_ImplSDL2_ProcessEvent(&event);
+            
+            if(event.type == SDL_QUIT){
+                exit = true;
+                break;
+            } else if(event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE){
+                exit = true;
+                break;
+            } else if(event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_SPACE && prefetcher){
+                fire_requested = true;
+            }
+        }
+    };
+    
+    //growing the texture arrays of a resolution class discards their layers, so all tiles and delayed mirrors have to be uploaded again
+    auto upload_all = [&](){
+        for(size_t i = 0; i < tiles.size(); i++){
+            renderer.uploadTile(i, tiles[i]->getFrame());
+        }
+        shared_decode.invalidateUploads();
+        for(size_t i = 0; i < shared_decode.getMirrorCount(); i++){
+            if(shared_decode.takeUpload(i, tiles)){
+                renderer.uploadTile(tiles.size() + i, shared_decode.getDelayedFrame(i, tiles));
+            }
+        }
+    };
+    
+    //advance every tile, hidden tiles only keep their time.
+    //Returns true if the output has to be redrawn because a tile changed.
+    auto update_tiles = [&](double delta, bool output_visible, const sakurajin::GridLayout& grid){
+        bool changed = false;
+        shared_decode.resolveSources(tiles);
+        for(size_t i = 0; i < tiles.size(); i++){
+            auto& tile = tiles[i];
+            auto rect = grid.getTileRect(i, fboWidth, fboHeight, tile->getAspectRatio());
+            
+            // Tell the reader how large the tile is so it only decodes the needed resolution
+            if(output_visible){
+                tile->setDisplaySize(static_cast<int>(rect.width), static_cast<int>(rect.height));
+            }
+            
+            //a tile that is hidden itself still decodes visible frames while a mirror shows them
+            bool slot_visible = output_visible && tile_controls[i].shown && rect.width >= 1.0f && rect.height >= 1.0f;
+            tile->setVisible(slot_visible || (output_visible && shared_decode.isFeedingMirror(i)));
+            tile->setPlaybackState(tile_controls[i].paused ? sakurajin::VideoTile::PlaybackState::paused : sakurajin::VideoTile::PlaybackState::playing);
+            tile->setPriority(tile_controls[i].priority);
+            //the slot of a tile was a mirror before if the tile was opened after the mirrors were added
+            renderer.setTileSource(i, i);
+            if(renderer.setTileRect(i, rect, slot_visible)){
+                changed = true;
+            }
+            
+            bool new_frame = tile->update(delta);
+            
+            //the variant follows the format of the current frame, so it is set after decoding.
+            //Requesting the variant starts building it, the tile is drawn once it is ready
+            auto key = tile->getShaderVariant();
+            key.grade = tile_controls[i].grade.enabled;
+            auto variant = key.pack();
+            renderer.setTileVariant(i, variant);
+            tile_shaders.get(variant);
+            if(renderer.setTileGrade(i, tile_controls[i].grade)){
+                changed = true;
+            }
+            
+            if(!new_frame){
+                continue;
+            }
+            changed = true;
+            
+            if(renderer.reserveLayers(i, tile->getFrame())){
+                upload_all();
+            }else{
+                renderer.uploadTile(i, tile->getFrame());
+            }
+            
+            //the latency of a cue ends with the first frame of its tile, not of the one it replaces
+            if(cue_fire_time && i == 0 && !standby_tiles[0]){
+                cue_latency = std::chrono::duration<double>(std::chrono::steady_clock::now() - *cue_fire_time).count();
+                cue_fire_time.reset();
+            }
+        }
+        
+        //mirrors without delay draw the layers of their source, so a new frame of the source
+        //already changed the output. Delayed mirrors upload frames from the history of the source.
+        for(size_t i = 0; i < shared_decode.getMirrorCount(); i++){
+            const size_t slot = tiles.size() + i;
+            const auto& mirror = shared_decode.getMirror(i);
+            const size_t source = shared_decode.getSource(i);
+            if(source == sakurajin::SharedDecode::noSource){
+                renderer.setTileRect(slot, grid.getTileRect(slot, fboWidth, fboHeight, 16.0f / 9.0f), false);
+                continue;
+            }
+            
+            auto& source_tile = tiles[source];
+            auto rect = grid.getTileRect(slot, fboWidth, fboHeight, source_tile->getAspectRatio());
+            if(renderer.setTileRect(slot, rect, output_visible && mirror.shown && rect.width >= 1.0f && rect.height >= 1.0f)){
+                changed = true;
+            }
+            
+            if(mirror.delay <= 0.0){
+                renderer.setTileSource(slot, source);
+                renderer.setTileVariant(slot, source_tile->getShaderVariant().pack());
+                continue;
+            }
+            
+            renderer.setTileSource(slot, slot);
+            if(!shared_decode.takeUpload(i, tiles)){
+                continue;
+            }
+            changed = true;
+            
+            const auto& frame = shared_decode.getDelayedFrame(i, tiles);
+            auto key = source_tile->getShaderVariant();
+            key.pixelFormat = frame.format;
+            renderer.setTileVariant(slot, key.pack());
+            tile_shaders.get(key.pack());
+            
+            if(renderer.reserveLayers(slot, frame)){
+                upload_all();
+            }else{
+                renderer.uploadTile(slot, frame);
+            }
+        }
+        
+        //the placeholders are drawn by the output window
+        for(size_t i = tiles.size() + shared_decode.getMirrorCount(); i < get_slot_count(); i++){
+            renderer.setTileRect(i, grid.getTileRect(i, fboWidth, fboHeight, 16.0f / 9.0f), false);
+        }
+        return changed;
+    };
+    
+    //the FBO keeps the last output, it is only redrawn if a tile or the layout changed
+    bool output_dirty = true;
+    bool last_output_visible = false;
+    uint64_t last_fbo_width = 0, last_fbo_height = 0;
+    uint64_t frame_count = 0, redraw_count = 0;
+    
+    //the allocation check starts once every tile had time to reach its steady state
+    const uint64_t allocation_check_warmup = 300;
+    uint64_t loop_count = 0;
+    
+    //the placeholders take the slots after the open tiles. Tiles can move to other
+    //slots when one is closed, so every open tile is uploaded again
+    auto resize_grid = [&](){
+        const size_t slots = get_slot_count();
+        layout = sakurajin::GridLayout{slots};
+        renderer.setTileCount(slots);
+        upload_all();
+        output_dirty = true;
+    };
+    
+    //opened tiles replace their placeholder in the order they were opened, so the grid
+    //keeps the order of the files. Their first frame is decoded already, so the
+    //changeover only uploads it.
+    auto take_opened_tiles = [&](){
+        bool changed = false;
+        while(!pending_tiles.empty()){
+            auto& pending = pending_tiles.front();
+            auto state = pending->poll();
+            if(state == sakurajin::PendingTile::State::opening){
+                break;
+            }
+            if(state == sakurajin::PendingTile::State::failed){
+                printf("Couldn't open video file %s\n", pending->getFilename().c_str());
+            }
+            auto opened = pending->takeAll();
+            const auto& request = pending_requests.front();
+            for(int repeat = 0; repeat < request.repeats; repeat++){
+                for(const auto& tile : opened){
+                    sakurajin::SharedDecode::Mirror mirror;
+                    mirror.filename = tile->getFilename();
+                    mirror.stream = tile->getStream();
+                    mirror.reverse = request.reverse;
+                    shared_decode.addMirror(mirror);
+                }
+            }
+            for(auto& tile : opened){
+                tiles.emplace_back(std::move(tile));
+                tile_controls.emplace_back();
+                standby_tiles.emplace_back();
+            }
+            pending_tiles.erase(pending_tiles.begin());
+            pending_requests.erase(pending_requests.begin());
+            changed = true;
+        }
+        if(changed){
+            resize_grid();
+        }
+    };
+    
+    //a standby tile is swapped in on the first tick after it is ready, the old tile is
+    //shown until then, so the slot never shows a gap. The old tile is closed in the background.
+    auto swap_standby_tiles = [&](){
+        for(size_t i = 0; i < tiles.size(); i++){
+            auto& standby = standby_tiles[i];
+            if(!standby || standby->poll() == sakurajin::PendingTile::State::opening){
+                continue;
+            }
+            if(auto tile = standby->take()){
+                clip_opener.close(std::move(tiles[i]));
+                tiles[i] = std::move(tile);
+            }
+            standby.reset();
+        }
+    };
+    
+    char open_filename[512] = "";
+    
+    auto last_frame_time = std::chrono::steady_clock::now();
     while (!exit) {
-        sakurajin::imguiHandler::startRender();
+        auto now = std::chrono::steady_clock::now();
+        double delta = std::chrono::duration<double>(now - last_frame_time).count();
+        last_frame_time = now;
+        loop_count++;
         
-        ImGui::Begin("video out");
+        //switch cues before the standby tiles are swapped in, so the first frame of a warm cue is shown right away
+        if(prefetcher){
+            prefetcher->update();
+            if(std::exchange(fire_requested, false)){
+                fire_cue();
+            }
+        }
+        
+        //there is nothing to show once every file failed to open
+        take_opened_tiles();
+        swap_standby_tiles();
+        if(tiles.empty() && pending_tiles.empty()){
+            printf("Couldn't open video file (make sure you set a video file that exists)\n");
+            return 1;
+        }
+        
+        //nothing can be seen while minimized, so only keep the time and don't render at all
+        if(sakurajin::imguiHandler::isMinimized()){
+            last_output_visible = false;
+            output_target.reset();
+            framebuffer_pool.endFrame();
+            try{
+                update_tiles(delta, false, layout);
+            }catch(const std::exception& e){
+                sakurajin::Helper::print_exception(e);
+                return 1;
+            }
             
-            //update the viewport and load the fbo
-            fboHeight = ImGui::GetWindowHeight();
-            fboWidth = ImGui::GetWindowWidth();
+            poll_events();
             
+            //there is no vsync while minimized, so wait instead of spinning
+            std::this_thread::sleep_for(10ms);
+            continue;
+        }
+        
+        sakurajin::imguiHandler::startRender();
+        
+        //pick up the shaders the driver finished, a reloaded shader changes the output
+        try{
+            if(shader_manager.update()){
+                output_dirty = true;
+            }
+        }catch(const std::exception& e){
+            sakurajin::Helper::print_exception(e);
+            return 1;
+        }
+        
+        //a collapsed output window only keeps the time as well
+        bool output_visible = ImGui::Begin("video out");
+        
+            //update the viewport and load the fbo
             auto size = ImGui::GetContentRegionAvail();
             auto max = ImGui::GetWindowContentRegionMax();
             auto min = ImGui::GetWindowContentRegionMin();
@@ -109,57 +569,147 @@ int main(int argc, const char** argv) {
             fboWidth = size.x;
             fboHeight = size.y;
             
-            sakurajin::imguiHandler::loadFramebuffer(FBO,fboWidth,fboHeight);
+            // Read new frames and load them into the textures
+            bool counting_allocations = allocation_check && loop_count > allocation_check_warmup;
+            if(counting_allocations){
+                sakurajin::AllocationCounter::start();
+            }
+            try{
+                if(update_tiles(delta, output_visible, layout)){
+                    output_dirty = true;
+                }
+            }catch(const std::exception& e){
+                sakurajin::Helper::print_exception(e);
+                return 1;
+            }
+            if(counting_allocations){
+                auto allocations = sakurajin::AllocationCounter::stop();
+                if(allocations.allocations > 0){
+                    printf("allocation check failed: %lu allocations (%lu bytes) while updating the tiles in frame %lu\n", allocations.allocations, allocations.bytes, loop_count);
+                    return 1;
+                }
+            }
+            
+            //a resized or reopened window changes the layout, so everything has to be drawn again
+            if(fboWidth != last_fbo_width || fboHeight != last_fbo_height || output_visible != last_output_visible){
+                output_dirty = true;
+                last_fbo_width = fboWidth;
+                last_fbo_height = fboHeight;
+                last_output_visible = output_visible;
+            }
+            
+            //a hidden output gives its target back to the pool, so the memory can be freed
+            if(output_visible){
+                auto previous_target = output_target.get();
+                try{
+                    framebuffer_pool.resize(output_target, fboWidth, fboHeight);
+                }catch(const std::exception& e){
+                    sakurajin::Helper::print_exception(e);
+                    return 1;
+                }
+                if(output_target.get() != previous_target){
+                    output_dirty = true;
+                }
+            }else{
+                output_target.reset();
+            }
+            
+        if(output_visible){
+            frame_count++;
+        }
+        
+        //only the effect programs have to be built before drawing, a tile whose variant is still
+        //building is left out of the grid and the output stays dirty until the variant is ready
+        if(output_visible && output_dirty && effects->isReady()){
+            output_dirty = false;
+            redraw_count++;
             
-            outputShader->use();
-            //create and update the projection matrix
-            float camMult = 0.8;
-            auto orth = glm::ortho(
-                -16.0f, 
-                camMult * 9.0f * fboWidth / fboHeight,
-                -9.0f,
-                camMult * 16.0f * fboHeight / fboWidth,
+            //the FBO is shown flipped by ImGui, so y=0 is the top of the output
+            sakurajin::FrameUniforms frame;
+            frame.projection = glm::ortho(
+                0.0f,
+                static_cast<float>(fboWidth),
+                0.0f,
+                static_cast<float>(fboHeight),
                 -10.0f,
                 10.0f
             );
-            outputShader->setUniform("transform", orth);
-
-            // Read a new frame and load it into texture
-            int64_t pts;
-            if (!video_reader_read_frame(&vr_state, frame_data, &pts)) {
-                printf("Couldn't load video frame\n");
-                return 1;
-            }
-
-            //activate the texture and the shader
-            glActiveTexture(GL_TEXTURE0);
-            glBindTexture(GL_TEXTURE_2D, texRGB);
-            glTexImage2D(
-                GL_TEXTURE_2D, 
-                0, 
-                GL_RGBA, 
-                vr_state.width, 
-                vr_state.height, 
-                0, 
-                GL_RGBA, 
-                GL_UNSIGNED_BYTE, 
-                frame_data
-            );
+            frame.outputSize = glm::vec4(fboWidth, fboHeight, 0.0f, 0.0f);
+            frame_uniforms.update(frame);
             
-            //draw the rectangle
-            glBindVertexArray(VAO);
-            glDrawElements(GL_TRIANGLES, 6, GL_UNSIGNED_INT, 0);
+            //without effects the grid is drawn straight into the output target
+            render_graph.reset();
+            auto output = render_graph.importTarget("output", output_target);
+            auto grid = effects->isActive() ? render_graph.createTarget("grid") : output;
             
-            glBindVertexArray(0);
-            glBindFramebuffer(GL_FRAMEBUFFER, 0);
+            render_graph.addPass("grid", {}, grid, [&](const sakurajin::RenderGraph::PassResources& resources){
+                resources.output->clear(0.7f, 0.7f, 0.0f, 0.0f);
+                
+                //draw the visible tiles, one instanced draw call per shader variant and resolution class
+                if(!renderer.draw(tile_shaders)){
+                    output_dirty = true;
+                }
+            });
             
-            ImGui::Image((void*)(intptr_t)outTexture, size);
+            try{
+                effects->addPasses(render_graph, framebuffer_pool, grid, output, fboWidth, fboHeight);
+                render_graph.execute(framebuffer_pool, fboWidth, fboHeight);
+            }catch(const std::exception& e){
+                sakurajin::Helper::print_exception(e);
+                return 1;
+            }
+        }
+        
+        //effects that use the previous frame change the output even without new video frames
+        if(effects->needsContinuousRedraw()){
+            output_dirty = true;
+        }
+        
+        //ImGui always composes the cached FBO texture, even if nothing was redrawn
+        if(output_visible){
+            //only show the used part of the target, it can be larger than the window
+            ImGui::Image((void*)(intptr_t)output_target->getTexture(), size, ImVec2(0, 0), output_target->getUsedUV());
+            
+            //mark the slots of the tiles that are still opening
+            auto origin = ImGui::GetItemRectMin();
+            const size_t first_placeholder = tiles.size() + shared_decode.getMirrorCount();
+            for(size_t i = 0; i < pending_tiles.size(); i++){
+                auto rect = layout.getTileRect(first_placeholder + i, fboWidth, fboHeight, 16.0f / 9.0f);
+                ImVec2 rect_min{origin.x + rect.x, origin.y + rect.y};
+                ImVec2 rect_max{rect_min.x + rect.width, rect_min.y + rect.height};
+                ImGui::GetWindowDrawList()->AddRectFilled(rect_min, rect_max, IM_COL32(0, 0, 0, 255));
+                ImGui::GetWindowDrawList()->AddText(ImVec2(rect_min.x + 8.0f, rect_min.y + 8.0f), IM_COL32(255, 255, 255, 255), ("opening " + pending_tiles[i]->getFilename()).c_str());
+            }
             
             //show a tooltip and window borders when the window is hovered
             if(ImGui::IsItemHovered()){
                 ImGui::BeginTooltip();
-                ImGui::Text("pointer = %u", outTexture);
+                ImGui::Text("pointer = %u", output_target->getTexture());
+                ImGui::Text("target = %d x %d", output_target->getWidth(), output_target->getHeight());
+                ImGui::Text("framebuffer pool = %lu targets, %.1f MiB", framebuffer_pool.getTargetCount(), framebuffer_pool.getAllocatedBytes() / (1024.0 * 1024.0));
+                auto memory_stats = frame_memory.getStats();
+                ImGui::Text("frame memory = %.1f MiB in use (peak %.1f MiB), %.1f MiB cached, %.1f MiB huge pages", memory_stats.bytesInUse / (1024.0 * 1024.0), memory_stats.peakBytesInUse / (1024.0 * 1024.0), memory_stats.bytesCached / (1024.0 * 1024.0), memory_stats.hugePageBytes / (1024.0 * 1024.0));
+                auto packet_stats = packet_pool.getStats();
+                ImGui::Text("packet pool = %lu packets, %lu frames allocated, %lu reused", packet_stats.packetAllocations, packet_stats.frameAllocations, packet_stats.reuses);
+                if(clip_preloader){
+                    ImGui::Text("preloaded clips = %.1f MiB of %.1f MiB budget", clip_preloader->getReservedBytes() / (1024.0 * 1024.0), clip_preloader->getConfig().memoryBudget / (1024.0 * 1024.0));
+                    for(const auto& clip : clip_preloader->getClips()){
+                        ImGui::Text("  %s: %.0f%% of %.1f MiB", clip->getFilename().c_str(), clip->getProgress() * 100.0f, clip->getSize() / (1024.0 * 1024.0));
+                    }
+                }
+                if(io_scheduler){
+                    auto io_stats = io_scheduler->getStats();
+                    ImGui::Text("io %s = %.1f MiB/s, queue depth %u (peak %u), %lu stalled reads", io_stats.ioUring ? "uring" : "threads", io_stats.throughput / (1024.0 * 1024.0), io_stats.queueDepth, io_stats.peakQueueDepth, io_stats.stalls);
+                }
+                ImGui::Text("frame buffers = %lu acquired, %lu reused, %lu allocated, %lu freed", memory_stats.acquires, memory_stats.reuses, memory_stats.systemAllocations, memory_stats.systemFrees);
                 ImGui::Text("size = %lu x %lu", fboWidth, fboHeight);
+                ImGui::Text("redrawn in %lu of %lu frames", redraw_count, frame_count);
+                ImGui::Text("frame uniform uploads = %lu", frame_uniforms.getUploadCount());
+                ImGui::Text("texture layers = %d x %d, resolution classes = %lu", renderer.getLayerWidth(), renderer.getLayerHeight(), renderer.getLayerClassCount());
+                ImGui::Text("draw calls = %lu, shader variants = %lu", renderer.getDrawCallCount(), tile_shaders.getVariantCount());
+                for(const auto& tile : tiles){
+                    ImGui::Text("%s: %d x %d, %s", tile->getFilename().c_str(), tile->getFrameWidth(), tile->getFrameHeight(), tile->getShaderVariant().describe().c_str());
+                }
                 ImGui::EndTooltip();
                 
                 ImVec2 vMin = ImGui::GetWindowContentRegionMin();
@@ -172,30 +722,157 @@ int main(int argc, const char** argv) {
 
                 ImGui::GetForegroundDrawList()->AddRect( vMin, vMax, IM_COL32( 255, 255, 0, 255 ) );
             }
+        }
         
         ImGui::End();
-
-        sakurajin::imguiHandler::endRender();
         
-        while(SDL_PollEvent(&event)){
-            ImGui_ImplSDL2_ProcessEvent(&event);
-            
-            if(event.type == SDL_QUIT){
-                exit = true;
-                break;
-            } else if(event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE){
-                exit = true;
-                break;
+        //let the user pause or hide the individual tiles and open new ones
+        ImGui::Begin("tiles");
+            ImGui::InputText("file", open_filename, sizeof(open_filename));
+            ImGui::SameLine();
+            if(ImGui::Button("open") && open_filename[0] != '\0'){
+                open_clip(open_filename);
+                resize_grid();
+            }
+            for(size_t i = 0; i < shared_decode.getMirrorCount(); i++){
+                auto& mirror = shared_decode.getMirror(i);
+                ImGui::PushID(static_cast<int>(tiles.size() + i));
+                auto source = shared_decode.getSource(i);
+                if(source == sakurajin::SharedDecode::noSource){
+                    ImGui::Text("%s (mirror, waiting for the clip)", mirror.filename.c_str());
+                }else{
+                    ImGui::Text("%s (mirror of tile %lu)", mirror.filename.c_str(), source + 1);
+                }
+                ImGui::Checkbox("shown", &mirror.shown);
+                float delay = static_cast<float>(mirror.delay);
+                if(ImGui::SliderFloat("delay", &delay, 0.0f, static_cast<float>(sakurajin::SharedDecode::maxDelay))){
+                    mirror.delay = delay;
+                }
+                ImGui::PopID();
+            }
+            for(size_t i = 0; i < pending_tiles.size(); i++){
+                ImGui::PushID(static_cast<int>(tiles.size() + shared_decode.getMirrorCount() + i));
+                ImGui::Text("%s (opening)", pending_tiles[i]->getFilename().c_str());
+                ImGui::SameLine();
+                if(ImGui::Button("cancel")){
+                    pending_tiles[i]->cancel();
+                }
+                ImGui::PopID();
+            }
+            ImGui::Separator();
+            for(size_t i = 0; i < tiles.size(); i++){
+                ImGui::PushID(static_cast<int>(i));
+                ImGui::Text("%s stream %d (%.2fs)", tiles[i]->getFilename().c_str(), tiles[i]->getStream(), tiles[i]->getPlayhead());
+                ImGui::Checkbox("shown", &tile_controls[i].shown);
+                ImGui::SameLine();
+                ImGui::Checkbox("paused", &tile_controls[i].paused);
+                ImGui::SliderInt("priority", &tile_controls[i].priority, -10, 10);
+                ImGui::Checkbox("grade", &tile_controls[i].grade.enabled);
+                if(tile_controls[i].grade.enabled){
+                    ImGui::SliderFloat("brightness", &tile_controls[i].grade.brightness, -1.0f, 1.0f);
+                    ImGui::SliderFloat("contrast", &tile_controls[i].grade.contrast, 0.0f, 2.0f);
+                    ImGui::SliderFloat("saturation", &tile_controls[i].grade.saturation, 0.0f, 2.0f);
+                }
+                ImGui::Text("quality level %d: %s", tiles[i]->getQualityLevel(), tiles[i]->getQualityDescription());
+                if(auto clip = tiles[i]->getPreloadedClip()){
+                    ImGui::Text("preloaded, %.1f MiB resident", clip->getLoadedBytes() / (1024.0 * 1024.0));
+                }else{
+                    ImGui::Text("read from disk");
+                }
+                
+                //replace the clip of the tile with the file above, a new request replaces the standby
+                if(ImGui::Button("replace") && open_filename[0] != '\0'){
+                    if(standby_tiles[i]){
+                        standby_tiles[i]->cancel();
+                    }
+                    standby_tiles[i] = clip_opener.open(open_filename, reverse_playback);
+                }
+                if(standby_tiles[i]){
+                    ImGui::SameLine();
+                    ImGui::Text("next: %s (opening)", standby_tiles[i]->getFilename().c_str());
+                    ImGui::SameLine();
+                    if(ImGui::Button("cancel")){
+                        standby_tiles[i]->cancel();
+                    }
+                }
+                ImGui::PopID();
+            }
+        ImGui::End();
+        
+        //show the upcoming cues and if they are warm yet
+        if(prefetcher){
+            ImGui::Begin("setlist");
+                if(ImGui::Button("go")){
+                    fire_requested = true;
+                }
+                ImGui::SameLine();
+                if(ImGui::Button("skip")){
+                    prefetcher->skip();
+                }
+                ImGui::Text("first frame of the last cue after %.2fms", cue_latency * 1000.0);
+                ImGui::Separator();
+                for(size_t i = 0; i < prefetcher->getCueCount(); i++){
+                    const char* marker = i == prefetcher->getNextCue() ? ">" : " ";
+                    auto state = sakurajin::CuePrefetcher::getStateName(prefetcher->getCueState(i));
+                    ImGui::Text("%s %lu %s: %s", marker, i + 1, prefetcher->getCue(i).filename.c_str(), state);
+                }
+            ImGui::End();
+        }
+        
+        //show what the governor is doing so the priorities can be tuned
+        ImGui::Begin("quality governor");
+            ImGui::Checkbox("enabled", &governor_enabled);
+            ImGui::Text("work time %.2fms of %.2fms", governor.getSmoothedWorkTime() * 1000.0, governor.getFrameBudget() * 1000.0);
+            ImGui::Separator();
+            for(const auto& decision : governor.getDecisions()){
+                ImGui::TextUnformatted(decision.c_str());
+            }
+        ImGui::End();
+        
+        //the effects are applied to the whole output, a change needs a redraw
+        ImGui::Begin("effects");
+            auto& effect_settings = effects->settings;
+            bool effects_changed = false;
+            effects_changed |= ImGui::Checkbox("grade", &effect_settings.gradeEnabled);
+            effects_changed |= ImGui::SliderFloat("brightness", &effect_settings.brightness, -1.0f, 1.0f);
+            effects_changed |= ImGui::SliderFloat("contrast", &effect_settings.contrast, 0.0f, 2.0f);
+            effects_changed |= ImGui::SliderFloat("saturation", &effect_settings.saturation, 0.0f, 2.0f);
+            ImGui::Separator();
+            effects_changed |= ImGui::Checkbox("blur", &effect_settings.blurEnabled);
+            effects_changed |= ImGui::SliderFloat("radius", &effect_settings.blurRadius, 0.0f, 16.0f);
+            ImGui::Separator();
+            effects_changed |= ImGui::Checkbox("feedback", &effect_settings.feedbackEnabled);
+            effects_changed |= ImGui::SliderFloat("amount", &effect_settings.feedbackAmount, 0.0f, 0.99f);
+            ImGui::Separator();
+            ImGui::Text("passes %lu, culled %lu, intermediate targets %lu", render_graph.getPassCount(), render_graph.getCulledPassCount(), render_graph.getTransientTargetCount());
+            ImGui::Text("shaders building %lu, reloaded %lu", shader_manager.getBuildingCount(), shader_manager.getReloadCount());
+            if(!shader_manager.getLastError().empty()){
+                ImGui::TextWrapped("shader error: %s", shader_manager.getLastError().c_str());
             }
+            if(effects_changed){
+                output_dirty = true;
+            }
+        ImGui::End();
+        
+        //the time until here is the actual work, endRender waits for vsync
+        double work_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - now).count();
+        if(governor_enabled){
+            governor.update(work_time, delta, tiles);
         }
-        /*
-        double pt_in_seconds = pts * (double)vr_state.time_base.num / (double)vr_state.time_base.den;
-        while (pt_in_seconds > glfwGetTime()) {
-            glfwWaitEventsTimeout(pt_in_seconds - glfwGetTime());
-        }*/
+
+        sakurajin::imguiHandler::endRender();
+        framebuffer_pool.endFrame();
+        
+        poll_events();
     }
 
-    video_reader_close(&vr_state);
+    tiles.clear();
+    pending_tiles.clear();
+    standby_tiles.clear();
+    prefetcher.reset();
+    effects.reset();
+    render_graph.reset();
+    output_target.reset();
 
     return 0;
 }
@@ -0,0 +1,46 @@
+#include "media_resources.hpp"
+
+namespace{
+    //how often a cancellable tile checks its flag while it waits for a preloaded clip
+    constexpr std::chrono::milliseconds cancelCheckInterval{20};
+}
+
+std::shared_ptr<sakurajin::PreloadedClip> sakurajin::MediaResources::loadClip ( const std::string& filename ) const {
+    if(!preloader){
+        return nullptr;
+    }
+
+    auto clip = preloader->preload(filename);
+    if(!clip){
+        return nullptr;
+    }
+
+    //a tile opened in the background stops waiting once it is cancelled,
+    //the clip keeps loading for the next tile that wants it
+    if(cancelled){
+        while(!clip->waitFor(cancelCheckInterval)){
+            if(*cancelled){
+                return nullptr;
+            }
+        }
+    }else if(!clip->wait()){
+        return nullptr;
+    }
+
+    if(clip->getState() != PreloadedClip::State::ready){
+        return nullptr;
+    }
+    return clip;
+}
+
+void sakurajin::MediaResources::configureReader ( VideoReaderState* reader, const PreloadedClip* clip ) const {
+    reader->packet_pool = &packets;
+    reader->io_scheduler = ioScheduler;
+    reader->use_mmap = mapFiles;
+    reader->abort_flag = cancelled.get();
+
+    if(clip){
+        reader->memory_data = clip->getData();
+        reader->memory_size = clip->getSize();
+    }
+}
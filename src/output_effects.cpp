@@ -0,0 +1,132 @@
+#include "output_effects.hpp"
+
+sakurajin::OutputEffects::OutputEffects(ShaderManager& shaderManager) {
+    try{
+        gradeShader = shaderManager.load("data/effects/fullscreen.vert", "data/effects/grade.frag");
+        blurShader = shaderManager.load("data/effects/fullscreen.vert", "data/effects/blur.frag");
+        feedbackShader = shaderManager.load("data/effects/fullscreen.vert", "data/effects/feedback.frag");
+        copyShader = shaderManager.load("data/effects/fullscreen.vert", "data/effects/copy.frag");
+    }catch(...){
+        std::throw_with_nested(std::runtime_error("could not load the effect shaders"));
+    }
+
+    //assign the samplers to the texture units, the values are applied once the programs are built
+    for(auto& shader : {gradeShader, blurShader, feedbackShader, copyShader}){
+        shader->setUniform("Input0", 0);
+        shader->setUniform("Input1", 1);
+    }
+
+    uniforms.brightness = gradeShader->getUniform("brightness");
+    uniforms.contrast = gradeShader->getUniform("contrast");
+    uniforms.saturation = gradeShader->getUniform("saturation");
+    uniforms.blurDirection = blurShader->getUniform("direction");
+    uniforms.blurRadius = blurShader->getUniform("radius");
+    uniforms.feedbackAmount = feedbackShader->getUniform("amount");
+
+    glGenVertexArrays(1, &emptyVAO);
+}
+
+sakurajin::OutputEffects::~OutputEffects() {
+    glDeleteVertexArrays(1, &emptyVAO);
+}
+
+bool sakurajin::OutputEffects::isActive() const {
+    return settings.gradeEnabled || settings.blurEnabled || settings.feedbackEnabled;
+}
+
+bool sakurajin::OutputEffects::needsContinuousRedraw() const {
+    return settings.feedbackEnabled;
+}
+
+bool sakurajin::OutputEffects::isReady() const {
+    for(const auto& shader : {gradeShader, blurShader, feedbackShader, copyShader}){
+        if(!shader->isReady()){
+            return false;
+        }
+    }
+    return true;
+}
+
+void sakurajin::OutputEffects::drawFullscreen() {
+    glBindVertexArray(emptyVAO);
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+    glBindVertexArray(0);
+}
+
+void sakurajin::OutputEffects::addPasses ( RenderGraph& graph, FramebufferPool& pool, RenderGraph::ResourceHandle input, RenderGraph::ResourceHandle output, int width, int height ) {
+    if(!settings.feedbackEnabled){
+        //the history is not needed anymore, the pool frees it after a while
+        history[0].reset();
+        history[1].reset();
+    }
+
+    if(!isActive()){
+        return;
+    }
+
+    //the last enabled effect writes straight into the output
+    auto current = input;
+    auto nextTarget = [&](const std::string& name, bool last){
+        return last ? output : graph.createTarget(name);
+    };
+
+    if(settings.gradeEnabled){
+        auto target = nextTarget("graded", !settings.blurEnabled && !settings.feedbackEnabled);
+        graph.addPass("grade", {current}, target, [this](const RenderGraph::PassResources&){
+            gradeShader->use();
+            gradeShader->setUniform(uniforms.brightness, glm::vec1(settings.brightness));
+            gradeShader->setUniform(uniforms.contrast, glm::vec1(settings.contrast));
+            gradeShader->setUniform(uniforms.saturation, glm::vec1(settings.saturation));
+            drawFullscreen();
+        });
+        current = target;
+    }
+
+    if(settings.blurEnabled){
+        //the blur is separable, the two directions ping-pong through an intermediate target
+        auto horizontal = graph.createTarget("blur horizontal");
+        auto target = nextTarget("blurred", !settings.feedbackEnabled);
+
+        auto blurPass = [this](glm::vec2 direction){
+            return [this, direction](const RenderGraph::PassResources&){
+                blurShader->use();
+                blurShader->setUniform(uniforms.blurDirection, direction);
+                blurShader->setUniform(uniforms.blurRadius, glm::vec1(settings.blurRadius));
+                drawFullscreen();
+            };
+        };
+
+        graph.addPass("blur horizontal", {current}, horizontal, blurPass(glm::vec2(1.0f, 0.0f)));
+        graph.addPass("blur vertical", {horizontal}, target, blurPass(glm::vec2(0.0f, 1.0f)));
+        current = target;
+    }
+
+    if(settings.feedbackEnabled){
+        auto& previous = history[historyIndex];
+        auto& next = history[1 - historyIndex];
+        historyIndex = 1 - historyIndex;
+
+        //a new or resized history has no usable content yet
+        auto previousTarget = previous.get();
+        pool.resize(previous, width, height);
+        if(previous.get() != previousTarget){
+            previous->bind();
+            previous->clear(0.0f, 0.0f, 0.0f, 0.0f);
+        }
+        pool.resize(next, width, height);
+
+        auto previousHandle = graph.importTarget("feedback previous", previous);
+        auto nextHandle = graph.importTarget("feedback next", next);
+
+        graph.addPass("feedback", {current, previousHandle}, nextHandle, [this](const RenderGraph::PassResources&){
+            feedbackShader->use();
+            feedbackShader->setUniform(uniforms.feedbackAmount, glm::vec1(settings.feedbackAmount));
+            drawFullscreen();
+        });
+
+        graph.addPass("present feedback", {nextHandle}, output, [this](const RenderGraph::PassResources&){
+            copyShader->use();
+            drawFullscreen();
+        });
+    }
+}
@@ -0,0 +1,90 @@
+#include "packet_pool.hpp"
+
+sakurajin::PacketPool::PacketPool ( size_t preallocatedPackets, size_t preallocatedFrames ) {
+    packets.reserve(preallocatedPackets);
+    for(size_t i = 0; i < preallocatedPackets; i++){
+        if(auto packet = av_packet_alloc()){
+            packets.emplace_back(packet);
+            stats.packetAllocations++;
+        }
+    }
+
+    frames.reserve(preallocatedFrames);
+    for(size_t i = 0; i < preallocatedFrames; i++){
+        if(auto frame = av_frame_alloc()){
+            frames.emplace_back(frame);
+            stats.frameAllocations++;
+        }
+    }
+}
+
+sakurajin::PacketPool::~PacketPool() {
+    for(auto& packet : packets){
+        av_packet_free(&packet);
+    }
+    for(auto& frame : frames){
+        av_frame_free(&frame);
+    }
+}
+
+AVPacket* sakurajin::PacketPool::acquirePacket() {
+    {
+        std::scoped_lock lock{mutex};
+        if(!packets.empty()){
+            auto packet = packets.back();
+            packets.pop_back();
+            stats.reuses++;
+            return packet;
+        }
+        stats.packetAllocations++;
+    }
+
+    return av_packet_alloc();
+}
+
+AVFrame* sakurajin::PacketPool::acquireFrame() {
+    {
+        std::scoped_lock lock{mutex};
+        if(!frames.empty()){
+            auto frame = frames.back();
+            frames.pop_back();
+            stats.reuses++;
+            return frame;
+        }
+        stats.frameAllocations++;
+    }
+
+    return av_frame_alloc();
+}
+
+void sakurajin::PacketPool::release ( AVPacket*& packet ) {
+    if(!packet){
+        return;
+    }
+
+    av_packet_unref(packet);
+
+    std::scoped_lock lock{mutex};
+    packets.emplace_back(packet);
+    packet = nullptr;
+}
+
+void sakurajin::PacketPool::release ( AVFrame*& frame ) {
+    if(!frame){
+        return;
+    }
+
+    av_frame_unref(frame);
+
+    std::scoped_lock lock{mutex};
+    frames.emplace_back(frame);
+    frame = nullptr;
+}
+
+sakurajin::PacketPool::Stats sakurajin::PacketPool::getStats() const {
+    std::scoped_lock lock{mutex};
+    auto result = stats;
+    result.idlePackets = packets.size();
+    result.idleFrames = frames.size();
+    return result;
+}
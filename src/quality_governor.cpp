@@ -0,0 +1,151 @@
+#include "quality_governor.hpp"
+
+#include <cstdio>
+
+namespace{
+    //tuning of the governor, all times are relative to the frame budget
+    constexpr double overloadThreshold = 0.9;
+    constexpr double headroomThreshold = 0.6;
+    constexpr double missedFrameThreshold = 1.2;
+    constexpr double smoothing = 0.1;
+
+    constexpr int degradeCooldown = 15;
+    constexpr int restoreCooldown = 60;
+    constexpr int headroomFramesNeeded = 120;
+    constexpr size_t maxDecisions = 32;
+}
+
+sakurajin::QualityGovernor::QualityGovernor ( double _frameBudget ) : frameBudget{_frameBudget} {}
+
+void sakurajin::QualityGovernor::setFrameBudget ( double _frameBudget ) {
+    frameBudget = _frameBudget;
+}
+
+double sakurajin::QualityGovernor::getFrameBudget() const {
+    return frameBudget;
+}
+
+double sakurajin::QualityGovernor::getSmoothedWorkTime() const {
+    return smoothedWorkTime;
+}
+
+const std::deque<std::string>& sakurajin::QualityGovernor::getDecisions() const {
+    return decisions;
+}
+
+void sakurajin::QualityGovernor::logDecision ( const std::string& decision ) {
+    char timing[64];
+    snprintf(timing, sizeof(timing), " (%.2fms of %.2fms)", smoothedWorkTime * 1000.0, frameBudget * 1000.0);
+
+    auto message = decision + timing;
+    std::cout << "quality governor: " << message << std::endl;
+
+    decisions.emplace_front(std::move(message));
+    if(decisions.size() > maxDecisions){
+        decisions.pop_back();
+    }
+}
+
+bool sakurajin::QualityGovernor::degrade ( const std::vector<std::unique_ptr<VideoTile>>& tiles ) {
+    //hidden and paused tiles are already cheap, so only degrade the ones that are shown.
+    //The lowest priority goes first, equal priorities are degraded evenly.
+    VideoTile* target = nullptr;
+    for(const auto& tile : tiles){
+        if(!tile->isVisible() || tile->getPlaybackState() != VideoTile::PlaybackState::playing){
+            continue;
+        }
+        if(tile->getQualityLevel() >= tile->getMaxQualityLevel()){
+            continue;
+        }
+
+        if(
+            target == nullptr ||
+            tile->getPriority() < target->getPriority() ||
+            (tile->getPriority() == target->getPriority() && tile->getQualityLevel() < target->getQualityLevel())
+        ){
+            target = tile.get();
+        }
+    }
+
+    if(target == nullptr){
+        return false;
+    }
+
+    target->setQualityLevel(target->getQualityLevel() + 1);
+    logDecision(
+        "degraded " + target->getFilename() +
+        " to level " + std::to_string(target->getQualityLevel()) +
+        ": " + target->getQualityDescription()
+    );
+    return true;
+}
+
+bool sakurajin::QualityGovernor::restore ( const std::vector<std::unique_ptr<VideoTile>>& tiles ) {
+    //the highest priority goes first, equal priorities are restored evenly
+    VideoTile* target = nullptr;
+    for(const auto& tile : tiles){
+        if(tile->getQualityLevel() == 0){
+            continue;
+        }
+
+        if(
+            target == nullptr ||
+            tile->getPriority() > target->getPriority() ||
+            (tile->getPriority() == target->getPriority() && tile->getQualityLevel() > target->getQualityLevel())
+        ){
+            target = tile.get();
+        }
+    }
+
+    if(target == nullptr){
+        return false;
+    }
+
+    target->setQualityLevel(target->getQualityLevel() - 1);
+    logDecision(
+        "restored " + target->getFilename() +
+        " to level " + std::to_string(target->getQualityLevel()) +
+        ": " + target->getQualityDescription()
+    );
+    return true;
+}
+
+void sakurajin::QualityGovernor::update ( double workTime, double frameInterval, const std::vector<std::unique_ptr<VideoTile>>& tiles ) {
+    //smooth the times so single spikes don't cause a decision
+    if(smoothedWorkTime <= 0.0){
+        smoothedWorkTime = workTime;
+        smoothedFrameInterval = frameInterval;
+    }else{
+        smoothedWorkTime += (workTime - smoothedWorkTime) * smoothing;
+        smoothedFrameInterval += (frameInterval - smoothedFrameInterval) * smoothing;
+    }
+
+    if(cooldown > 0){
+        cooldown--;
+        return;
+    }
+
+    //regularly missing vsync is an overload as well, even if the work time still looks fine
+    bool overloaded = smoothedWorkTime > frameBudget * overloadThreshold || smoothedFrameInterval > frameBudget * missedFrameThreshold;
+    if(overloaded){
+        headroomFrames = 0;
+        if(degrade(tiles)){
+            cooldown = degradeCooldown;
+        }
+        return;
+    }
+
+    //only restore after a longer time with headroom to avoid oscillating
+    if(smoothedWorkTime < frameBudget * headroomThreshold){
+        headroomFrames++;
+    }else{
+        headroomFrames = 0;
+    }
+
+    if(headroomFrames >= headroomFramesNeeded){
+        headroomFrames = 0;
+        if(restore(tiles)){
+            cooldown = restoreCooldown;
+        }
+    }
+}
@@ -0,0 +1,162 @@
+#include "render_graph.hpp"
+
+#include <algorithm>
+
+void sakurajin::RenderGraph::reset() {
+    resources.clear();
+    passes.clear();
+    writers.clear();
+    culledPassCount = 0;
+    transientTargetCount = 0;
+}
+
+sakurajin::RenderGraph::ResourceHandle sakurajin::RenderGraph::createTarget ( const std::string& name, GLenum format ) {
+    Resource resource;
+    resource.name = name;
+    resource.format = format;
+
+    resources.emplace_back(std::move(resource));
+    writers.emplace_back(-1);
+    return resources.size() - 1;
+}
+
+sakurajin::RenderGraph::ResourceHandle sakurajin::RenderGraph::importTarget ( const std::string& name, std::shared_ptr<Framebuffer> target ) {
+    if(!target){
+        throw std::invalid_argument("cannot import an empty target as " + name);
+    }
+
+    Resource resource;
+    resource.name = name;
+    resource.format = target->getFormat();
+    resource.imported = true;
+    resource.target = std::move(target);
+
+    resources.emplace_back(std::move(resource));
+    writers.emplace_back(-1);
+    return resources.size() - 1;
+}
+
+void sakurajin::RenderGraph::addPass ( const std::string& name, const std::vector<ResourceHandle>& inputs, ResourceHandle output, PassFunction execute ) {
+    if(output >= resources.size()){
+        throw std::out_of_range("pass " + name + " writes an unknown resource");
+    }
+    if(writers[output] >= 0){
+        throw std::invalid_argument("pass " + name + " writes " + resources[output].name + " which is already written by " + passes[writers[output]].name);
+    }
+
+    for(auto input : inputs){
+        if(input >= resources.size()){
+            throw std::out_of_range("pass " + name + " reads an unknown resource");
+        }
+        if(input == output){
+            throw std::invalid_argument("pass " + name + " reads and writes " + resources[input].name);
+        }
+        //imported targets can hold data from outside the graph, everything else has to be written first
+        if(writers[input] < 0 && !resources[input].imported){
+            throw std::invalid_argument("pass " + name + " reads " + resources[input].name + " before it is written");
+        }
+    }
+
+    writers[output] = passes.size();
+    passes.push_back({name, inputs, output, std::move(execute)});
+}
+
+void sakurajin::RenderGraph::compile() {
+    //walk backwards from the imported targets, a pass is only needed if its output is needed
+    for(auto& resource : resources){
+        resource.needed = resource.imported;
+        resource.lastReader = -1;
+    }
+
+    culledPassCount = 0;
+    for(auto pass = passes.rbegin(); pass != passes.rend(); ++pass){
+        pass->culled = !resources[pass->output].needed;
+        if(pass->culled){
+            culledPassCount++;
+            continue;
+        }
+
+        for(auto input : pass->inputs){
+            resources[input].needed = true;
+        }
+    }
+
+    //the last reader ends the lifetime of an intermediate target
+    for(size_t i = 0; i < passes.size(); i++){
+        if(passes[i].culled){
+            continue;
+        }
+        for(auto input : passes[i].inputs){
+            resources[input].lastReader = std::max(resources[input].lastReader, static_cast<int>(i));
+        }
+    }
+}
+
+void sakurajin::RenderGraph::execute ( FramebufferPool& pool, int width, int height ) {
+    compile();
+
+    std::vector<Framebuffer*> usedTargets;
+    for(size_t i = 0; i < passes.size(); i++){
+        auto& pass = passes[i];
+        if(pass.culled){
+            continue;
+        }
+
+        //intermediate targets are taken from the pool right before they are written
+        auto& output = resources[pass.output];
+        if(!output.target){
+            output.target = pool.acquire(width, height, output.format);
+        }
+        if(std::find(usedTargets.begin(), usedTargets.end(), output.target.get()) == usedTargets.end()){
+            usedTargets.emplace_back(output.target.get());
+        }
+
+        PassResources passResources;
+        passResources.output = output.target.get();
+        for(auto input : pass.inputs){
+            passResources.inputs.emplace_back(resources[input].target.get());
+        }
+
+        output.target->bind();
+        for(size_t unit = 0; unit < passResources.inputs.size(); unit++){
+            glActiveTexture(GL_TEXTURE0 + unit);
+            glBindTexture(GL_TEXTURE_2D, passResources.inputs[unit]->getTexture());
+        }
+        glActiveTexture(GL_TEXTURE0);
+
+        pass.execute(passResources);
+
+        //give the intermediate targets back as soon as nothing reads them anymore,
+        //so the following passes can alias their memory
+        for(auto input : pass.inputs){
+            auto& resource = resources[input];
+            if(!resource.imported && resource.lastReader == static_cast<int>(i)){
+                resource.target.reset();
+            }
+        }
+    }
+
+    transientTargetCount = 0;
+    for(auto target : usedTargets){
+        bool imported = std::any_of(resources.begin(), resources.end(), [target](const Resource& resource){
+            return resource.imported && resource.target.get() == target;
+        });
+        if(!imported){
+            transientTargetCount++;
+        }
+    }
+
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+}
+
+size_t sakurajin::RenderGraph::getPassCount() const {
+    return passes.size();
+}
+
+size_t sakurajin::RenderGraph::getCulledPassCount() const {
+    return culledPassCount;
+}
+
+size_t sakurajin::RenderGraph::getTransientTargetCount() const {
+    return transientTargetCount;
+}
@@ -1,4 +1,13 @@
 #include "shader.hpp"
+#include "shader_cache.hpp"
+#include "embedded_shaders.hpp"
+
+#include <cstring>
+
+//GL_KHR_parallel_shader_compile is not part of the generated loader
+#ifndef GL_COMPLETION_STATUS_KHR
+    #define GL_COMPLETION_STATUS_KHR 0x91B1
+#endif
 
 sakurajin::Shader_configuration::Shader_configuration() {}
 
@@ -7,6 +16,10 @@ sakurajin::Shader_configuration::Shader_configuration(const std::filesystem::pat
     fragment_shader_location{fragLoc}
     {}
     
+sakurajin::Shader_configuration::Shader_configuration(const std::filesystem::path& computeLoc):
+    compute_shader_location{computeLoc}
+    {}
+    
 sakurajin::Shader_configuration::Shader_configuration ( const sakurajin::Shader_configuration& other ) {
     vertex_shader_location = other.vertex_shader_location;
     fragment_shader_location = other.fragment_shader_location;
@@ -14,31 +27,61 @@ sakurajin::Shader_configuration::Shader_configuration ( const sakurajin::Shader_
     tessEvaluation_shader_location = other.tessEvaluation_shader_location;
     geometry_shader_location = other.geometry_shader_location;
     compute_shader_location = other.compute_shader_location;
+    defines = other.defines;
 }
 
 bool sakurajin::Shader_configuration::hasTessControlShader() const {
-    return !tessControl_shader_location.empty() && std::filesystem::exists(tessControl_shader_location);
+    return !tessControl_shader_location.empty() && EmbeddedShaders::exists(tessControl_shader_location);
 }
 
 bool sakurajin::Shader_configuration::hasTessEvaluationShader() const {
-    return !tessEvaluation_shader_location.empty() && std::filesystem::exists(tessEvaluation_shader_location);
+    return !tessEvaluation_shader_location.empty() && EmbeddedShaders::exists(tessEvaluation_shader_location);
 }
 
 bool sakurajin::Shader_configuration::hasGeometryShader() const {
-    return !geometry_shader_location.empty() && std::filesystem::exists(geometry_shader_location);
+    return !geometry_shader_location.empty() && EmbeddedShaders::exists(geometry_shader_location);
 }
 
 bool sakurajin::Shader_configuration::hasComputeShader() const {
-    return !compute_shader_location.empty() && std::filesystem::exists(compute_shader_location);
+    return !compute_shader_location.empty() && EmbeddedShaders::exists(compute_shader_location);
+}
+
+bool sakurajin::Shader_configuration::isComputeOnly() const {
+    return !compute_shader_location.empty() &&
+        vertex_shader_location.empty() &&
+        fragment_shader_location.empty() &&
+        geometry_shader_location.empty() &&
+        tessControl_shader_location.empty() &&
+        tessEvaluation_shader_location.empty();
+}
+    
+std::vector<std::filesystem::path> sakurajin::Shader_configuration::getStageLocations() const {
+    std::vector<std::filesystem::path> locations;
+    for(const auto& location : {
+        vertex_shader_location,
+        tessControl_shader_location,
+        tessEvaluation_shader_location,
+        geometry_shader_location,
+        fragment_shader_location,
+        compute_shader_location
+    }){
+        if(!location.empty()){
+            locations.emplace_back(location);
+        }
+    }
+    return locations;
 }
     
 bool sakurajin::Shader_configuration::isValid() const {
-    namespace fs = std::filesystem;
+    //a compute program only needs the compute shader
+    if(isComputeOnly()){
+        return EmbeddedShaders::exists(compute_shader_location);
+    }
     
     //check if required shader parts exist
     if(
-        ! fs::exists(vertex_shader_location) ||
-        ! fs::exists(fragment_shader_location)
+        ! EmbeddedShaders::exists(vertex_shader_location) ||
+        ! EmbeddedShaders::exists(fragment_shader_location)
     ){
         return false;
     }
@@ -46,32 +89,29 @@ bool sakurajin::Shader_configuration::isValid() const {
     //check if geometry shader exists if it is set
     if(
         ! geometry_shader_location.empty() &&
-        ! fs::exists(geometry_shader_location)
+        ! EmbeddedShaders::exists(geometry_shader_location)
     ){
         return false;
     }
     
-    //check if geometry shader exists if it is set
+    //check if tessalation control shader exists if it is set
     if(
         ! tessControl_shader_location.empty() &&
-        ! fs::exists(tessControl_shader_location)
+        ! EmbeddedShaders::exists(tessControl_shader_location)
     ){
         return false;
     }
     
-    //check if geometry shader exists if it is set
+    //check if tessalation evaluation shader exists if it is set
     if(
         ! tessEvaluation_shader_location.empty() &&
-        ! fs::exists(tessEvaluation_shader_location)
+        ! EmbeddedShaders::exists(tessEvaluation_shader_location)
     ){
         return false;
     }
     
-    //check if geometry shader exists if it is set
-    if(
-        ! compute_shader_location.empty() &&
-        ! fs::exists(compute_shader_location)
-    ){
+    //a compute shader can't be linked into the same program as the graphics stages
+    if(! compute_shader_location.empty()){
         return false;
     }
     
@@ -80,45 +120,32 @@ bool sakurajin::Shader_configuration::isValid() const {
 }
 
     
-sakurajin::Shader::Shader ( const sakurajin::Shader_configuration& config ) : shader_config{config} {
-    if(!shader_config.isValid()){
-        throw std::invalid_argument("Shder configuration is not valid!");
-    }
-    
-    try{
-        createShader();
-    }catch(...){
-        std::throw_with_nested( std::runtime_error("could not create Shader") );
-    }
-    
-}
+sakurajin::Shader::Shader ( const sakurajin::Shader_configuration& config ) : Shader{config, BuildMode::immediate} {}
 
-sakurajin::Shader::Shader ( sakurajin::Shader_configuration config ) : shader_config{config} {
-    if(!shader_config.isValid()){
-        throw std::invalid_argument("Shder configuration is not valid!");
-    }
-    
-    try{
-        createShader();
-    }catch(...){
-        std::throw_with_nested( std::runtime_error("could not create Shader") );
-    }
-}
+sakurajin::Shader::Shader ( sakurajin::Shader_configuration config ) : Shader{config, BuildMode::immediate} {}
 
-sakurajin::Shader::Shader ( const std::filesystem::path& vertLoc, const std::filesystem::path& fragLoc ) : shader_config{vertLoc, fragLoc} {
+sakurajin::Shader::Shader ( const sakurajin::Shader_configuration& config, BuildMode mode ) : shader_config{config} {
     if(!shader_config.isValid()){
-        throw std::invalid_argument("Shder configuration is not valid!");
+        throw std::invalid_argument("Shader configuration is not valid!");
     }
     
     try{
-        createShader();
+        startBuild();
+        if(mode == BuildMode::immediate){
+            finishBuild();
+        }
     }catch(...){
         std::throw_with_nested( std::runtime_error("could not create Shader") );
     }
 }
 
+sakurajin::Shader::Shader ( const std::filesystem::path& vertLoc, const std::filesystem::path& fragLoc ) : Shader{Shader_configuration{vertLoc, fragLoc}, BuildMode::immediate} {}
+
+sakurajin::Shader::Shader ( const std::filesystem::path& computeLoc ) : Shader{Shader_configuration{computeLoc}, BuildMode::immediate} {}
+
 
 sakurajin::Shader::~Shader() {
+    discardPendingBuild();
     glDeleteProgram(shaderProgram);
 }
 
@@ -128,144 +155,433 @@ void sakurajin::Shader::use() {
 }
 
 void sakurajin::Shader::setUniform ( const std::string& location, int value ) {
-    auto loc = glGetUniformLocation(shaderProgram, location.c_str() );
-    glUniform1i(loc, value);
+    setUniform(getUniform(location), value);
 }
 
 void sakurajin::Shader::setUniform ( const std::string& location, glm::vec1 value ) {
-    auto loc = glGetUniformLocation(shaderProgram, location.c_str() );
-    glUniform1f(loc, value.x);
+    setUniform(getUniform(location), value);
 }
 
 void sakurajin::Shader::setUniform ( const std::string& location, glm::vec2 value ) {
-    auto loc = glGetUniformLocation(shaderProgram, location.c_str() );
-    glUniform2f(loc, value.x, value.y);
+    setUniform(getUniform(location), value);
 }
 
 void sakurajin::Shader::setUniform ( const std::string& location, glm::vec3 value ) {
-    auto loc = glGetUniformLocation(shaderProgram, location.c_str() );
-    glUniform3f(loc, value.x, value.y, value.z);
+    setUniform(getUniform(location), value);
 }
 
 void sakurajin::Shader::setUniform ( const std::string& location, glm::vec4 value ) {
-    auto loc = glGetUniformLocation(shaderProgram, location.c_str() );
-    glUniform4f(loc, value.x, value.y, value.z, value.w);
+    setUniform(getUniform(location), value);
 }
 
 void sakurajin::Shader::setUniform ( const std::string& location, const glm::mat4& value ) {
-    auto loc = glGetUniformLocation(shaderProgram, location.c_str() );
-    glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(value));
+    setUniform(getUniform(location), value);
 }
 
+sakurajin::Shader::Uniform sakurajin::Shader::getUniform ( const std::string& name ) {
+    auto uniform = uniformIndices.find(name);
+    if(uniform != uniformIndices.end()){
+        return Uniform{uniform->second};
+    }
+    
+    //the name is kept even if the current program doesn't use it
+    UniformInfo info;
+    info.name = name;
+    info.location = shaderProgram ? glGetUniformLocation(shaderProgram, name.c_str()) : -1;
+    uniforms.emplace_back(std::move(info));
+    
+    int index = uniforms.size() - 1;
+    uniformIndices[name] = index;
+    return Uniform{index};
+}
 
-int sakurajin::Shader::createShader () {
-    std::string shaderCode;
+template<class T>
+void sakurajin::Shader::storeUniform ( Uniform uniform, ValueType type, const T& value ) {
+    static_assert(sizeof(T) <= sizeof(UniformInfo::value));
+    if(uniform.index < 0 || uniform.index >= static_cast<int>(uniforms.size())){
+        return;
+    }
     
-    //compile and load the vertex shader
-    unsigned int vertexShader = 0;
-    try{
-        shaderCode = loadFile( shader_config.vertex_shader_location );
-        compileShader(shaderCode, vertexShader, GL_VERTEX_SHADER);
-    }catch(...){
-        std::throw_with_nested(std::runtime_error("Could not compile or load vertex shader"));
+    //skip the GL call if the program already has this value
+    auto& info = uniforms[uniform.index];
+    if(info.type == type && std::memcmp(info.value.data(), &value, sizeof(T)) == 0){
+        return;
     }
     
-    //compile and load the fragment shader
-    unsigned int fragmentShader = 0;
-    try{
-        shaderCode = loadFile( shader_config.fragment_shader_location );
-        compileShader(shaderCode, fragmentShader, GL_FRAGMENT_SHADER);
-    }catch(...){
-        std::throw_with_nested(std::runtime_error("Could not compile or load fragment shader"));
+    std::memcpy(info.value.data(), &value, sizeof(T));
+    info.type = type;
+    applyUniform(info);
+}
+
+void sakurajin::Shader::applyUniform ( const UniformInfo& uniform ) {
+    if(!shaderProgram || uniform.location < 0){
+        return;
     }
     
-    //optional shader parts
-    unsigned int geometryShader = 0, computeShader = 0, tessControlShader = 0, tessEvalShader = 0;
+    int integer = 0;
+    float floats[16];
+    std::memcpy(&integer, uniform.value.data(), sizeof(integer));
+    std::memcpy(floats, uniform.value.data(), sizeof(floats));
     
-    //compile and load the geomerty shader
-    if(shader_config.hasGeometryShader()){
-        try{
-            shaderCode = loadFile( shader_config.geometry_shader_location );
-            compileShader(shaderCode, geometryShader, GL_GEOMETRY_SHADER);
-        }catch(...){
-            std::throw_with_nested(std::runtime_error("Could not compile or load geomerty shader"));
-        }
+    switch(uniform.type){
+        case ValueType::none:
+            break;
+        case ValueType::integer:
+            glProgramUniform1i(shaderProgram, uniform.location, integer);
+            break;
+        case ValueType::float1:
+            glProgramUniform1fv(shaderProgram, uniform.location, 1, floats);
+            break;
+        case ValueType::float2:
+            glProgramUniform2fv(shaderProgram, uniform.location, 1, floats);
+            break;
+        case ValueType::float3:
+            glProgramUniform3fv(shaderProgram, uniform.location, 1, floats);
+            break;
+        case ValueType::float4:
+            glProgramUniform4fv(shaderProgram, uniform.location, 1, floats);
+            break;
+        case ValueType::matrix4:
+            glProgramUniformMatrix4fv(shaderProgram, uniform.location, 1, GL_FALSE, floats);
+            break;
+    }
+}
+
+void sakurajin::Shader::setUniform ( Uniform uniform, int value ) {
+    storeUniform(uniform, ValueType::integer, value);
+}
+
+void sakurajin::Shader::setUniform ( Uniform uniform, glm::vec1 value ) {
+    storeUniform(uniform, ValueType::float1, value);
+}
+
+void sakurajin::Shader::setUniform ( Uniform uniform, glm::vec2 value ) {
+    storeUniform(uniform, ValueType::float2, value);
+}
+
+void sakurajin::Shader::setUniform ( Uniform uniform, glm::vec3 value ) {
+    storeUniform(uniform, ValueType::float3, value);
+}
+
+void sakurajin::Shader::setUniform ( Uniform uniform, glm::vec4 value ) {
+    storeUniform(uniform, ValueType::float4, value);
+}
+
+void sakurajin::Shader::setUniform ( Uniform uniform, const glm::mat4& value ) {
+    storeUniform(uniform, ValueType::matrix4, value);
+}
+
+bool sakurajin::Shader::bindUniformBlock ( const std::string& blockName, unsigned int binding ) {
+    auto blockIndex = glGetUniformBlockIndex(shaderProgram, blockName.c_str());
+    if(blockIndex == GL_INVALID_INDEX){
+        return false;
     }
     
-    //compile and load the compute shader
-    if(shader_config.hasComputeShader()){
-        try{
-            shaderCode = loadFile( shader_config.compute_shader_location );
-            compileShader(shaderCode, computeShader, GL_COMPUTE_SHADER);
-        }catch(...){
-            std::throw_with_nested(std::runtime_error("Could not compile or load compute shader"));
+    glUniformBlockBinding(shaderProgram, blockIndex, binding);
+    return true;
+}
+
+void sakurajin::Shader::resolveUniforms() {
+    //add every active uniform, so looking them up later never calls into GL
+    int uniformCount = 0, maxNameLength = 0;
+    glGetProgramiv(shaderProgram, GL_ACTIVE_UNIFORMS, &uniformCount);
+    glGetProgramiv(shaderProgram, GL_ACTIVE_UNIFORM_MAX_LENGTH, &maxNameLength);
+    
+    std::vector<char> nameBuffer(maxNameLength + 1);
+    for(int i = 0; i < uniformCount; i++){
+        GLsizei nameLength = 0;
+        GLint arraySize = 0;
+        GLenum type = 0;
+        glGetActiveUniform(shaderProgram, i, nameBuffer.size(), &nameLength, &arraySize, &type, nameBuffer.data());
+        
+        //arrays are reported as name[0], but GL also accepts the plain name
+        std::string name{nameBuffer.data(), static_cast<size_t>(nameLength)};
+        getUniform(name);
+        if(name.size() > 3 && name.compare(name.size() - 3, 3, "[0]") == 0){
+            getUniform(name.substr(0, name.size() - 3));
         }
     }
     
-    //compile and load the tessalation control shader
-    if(shader_config.hasTessControlShader()){
+    //the locations can be different in the new program, the known values have to be set again.
+    //Members of uniform blocks have no location, they are set through the buffer.
+    for(auto& uniform : uniforms){
+        uniform.location = glGetUniformLocation(shaderProgram, uniform.name.c_str());
+        applyUniform(uniform);
+    }
+}
+
+bool sakurajin::Shader::isCompute() const {
+    return shader_config.isComputeOnly();
+}
+
+std::array<int, 3> sakurajin::Shader::getWorkGroupSize() const {
+    return workGroupSize;
+}
+
+void sakurajin::Shader::dispatch ( unsigned int groupsX, unsigned int groupsY, unsigned int groupsZ ) {
+    if(!isCompute()){
+        throw std::logic_error("only compute shaders can be dispatched");
+    }
+    glDispatchCompute(groupsX, groupsY, groupsZ);
+}
+
+void sakurajin::Shader::dispatchForSize ( unsigned int width, unsigned int height, unsigned int depth ) {
+    if(!isCompute()){
+        throw std::logic_error("only compute shaders can be dispatched");
+    }
+    
+    auto groups = [](unsigned int size, int localSize){
+        return (size + localSize - 1) / localSize;
+    };
+    glDispatchCompute(groups(width, workGroupSize[0]), groups(height, workGroupSize[1]), groups(depth, workGroupSize[2]));
+}
+
+void sakurajin::Shader::bindImage ( unsigned int unit, unsigned int texture, GLenum access, GLenum format, int level, int layer ) {
+    bool layered = layer < 0;
+    glBindImageTexture(unit, texture, level, layered ? GL_TRUE : GL_FALSE, layered ? 0 : layer, access, format);
+}
+
+void sakurajin::Shader::bindStorageBuffer ( unsigned int binding, unsigned int buffer ) {
+    glBindBufferBase(GL_SHADER_STORAGE_BUFFER, binding, buffer);
+}
+
+void sakurajin::Shader::bindStorageBuffer ( unsigned int binding, unsigned int buffer, GLintptr offset, GLsizeiptr size ) {
+    glBindBufferRange(GL_SHADER_STORAGE_BUFFER, binding, buffer, offset, size);
+}
+
+void sakurajin::Shader::memoryBarrier ( GLbitfield barriers ) {
+    glMemoryBarrier(barriers);
+}
+
+std::vector<sakurajin::Shader::ShaderSource> sakurajin::Shader::loadSources() {
+    std::vector<ShaderSource> sources;
+    auto addStage = [&](const std::filesystem::path& location, int type, const std::string& name){
         try{
-            shaderCode = loadFile( shader_config.tessControl_shader_location );
-            compileShader(shaderCode, tessControlShader, GL_TESS_CONTROL_SHADER);
+            sources.push_back({type, injectDefines(loadFile(location))});
         }catch(...){
-            std::throw_with_nested(std::runtime_error("Could not compile or load tessalation control shader"));
+            std::throw_with_nested(std::runtime_error("Could not load " + name + " shader"));
         }
+    };
+    
+    //a compute program has no other stages
+    if(shader_config.isComputeOnly()){
+        addStage(shader_config.compute_shader_location, GL_COMPUTE_SHADER, "compute");
+        return sources;
     }
     
-    //compile and load the tessalation evalutaion shader
+    addStage(shader_config.vertex_shader_location, GL_VERTEX_SHADER, "vertex");
+    if(shader_config.hasTessControlShader()){
+        addStage(shader_config.tessControl_shader_location, GL_TESS_CONTROL_SHADER, "tessalation control");
+    }
     if(shader_config.hasTessEvaluationShader()){
-        try{
-            shaderCode = loadFile( shader_config.tessEvaluation_shader_location );
-            compileShader(shaderCode, tessEvalShader, GL_TESS_EVALUATION_SHADER);
-        }catch(...){
-            std::throw_with_nested(std::runtime_error("Could not compile or load tessalation evalutaion shader"));
+        addStage(shader_config.tessEvaluation_shader_location, GL_TESS_EVALUATION_SHADER, "tessalation evalutaion");
+    }
+    if(shader_config.hasGeometryShader()){
+        addStage(shader_config.geometry_shader_location, GL_GEOMETRY_SHADER, "geomerty");
+    }
+    addStage(shader_config.fragment_shader_location, GL_FRAGMENT_SHADER, "fragment");
+    
+    return sources;
+}
+
+std::string sakurajin::Shader::injectDefines ( const std::string& code ) const {
+    if(shader_config.defines.empty()){
+        return code;
+    }
+    
+    //the #version line has to stay the first one
+    size_t insertPosition = 0;
+    if(code.compare(0, 8, "#version") == 0){
+        insertPosition = code.find('\n');
+        insertPosition = insertPosition == std::string::npos ? code.size() : insertPosition + 1;
+    }
+    
+    std::string defines;
+    for(const auto& define : shader_config.defines){
+        defines.append("#define ").append(define.first).append(" ").append(define.second).append("\n");
+    }
+    
+    //keep the line numbers of the compiler errors matching the file
+    if(insertPosition > 0){
+        defines.append("#line 2\n");
+    }
+    
+    return code.substr(0, insertPosition) + defines + code.substr(insertPosition);
+}
+
+uint64_t sakurajin::Shader::hashSources ( const std::vector<ShaderSource>& sources ) {
+    uint64_t sourceHash = ShaderCache::hash(nullptr, 0);
+    for(const auto& source : sources){
+        sourceHash = ShaderCache::hash(&source.type, sizeof(source.type), sourceHash);
+        sourceHash = ShaderCache::hash(source.code.data(), source.code.size(), sourceHash);
+    }
+    return sourceHash;
+}
+
+void sakurajin::Shader::queryProgramInfo() {
+    resolveUniforms();
+    
+    //the local size is needed to get the number of work groups for a dispatch
+    if(shader_config.isComputeOnly()){
+        glGetProgramiv(shaderProgram, GL_COMPUTE_WORK_GROUP_SIZE, workGroupSize.data());
+    }
+}
+
+bool sakurajin::Shader::hasParallelCompile() {
+    //the extension can only change with the context, so it is checked once
+    static const bool supported = [](){
+        int extensionCount = 0;
+        glGetIntegerv(GL_NUM_EXTENSIONS, &extensionCount);
+        for(int i = 0; i < extensionCount; i++){
+            auto extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, i));
+            if(extension && (
+                std::strcmp(extension, "GL_KHR_parallel_shader_compile") == 0 ||
+                std::strcmp(extension, "GL_ARB_parallel_shader_compile") == 0
+            )){
+                return true;
+            }
         }
+        return false;
+    }();
+    return supported;
+}
+
+void sakurajin::Shader::discardPendingBuild() {
+    if(!pendingBuild){
+        return;
     }
-        //prepare the shader program to link every part
-    int success;
     
-    if(shaderProgram){
-        glDeleteProgram(shaderProgram);
+    for(auto shader : pendingBuild->shaders){
+        glDeleteShader(shader);
     }
-    shaderProgram = glCreateProgram();
+    glDeleteProgram(pendingBuild->program);
+    pendingBuild.reset();
+}
+
+void sakurajin::Shader::startBuild() {
+    //the files are read first, so a missing file keeps the running build
+    auto sources = loadSources();
+    discardPendingBuild();
     
-    glAttachShader(shaderProgram, vertexShader);
-    glAttachShader(shaderProgram, fragmentShader);
-    if(geometryShader){glAttachShader(shaderProgram, geometryShader);};
-    if(computeShader){glAttachShader(shaderProgram, computeShader);};
-    if(tessControlShader){glAttachShader(shaderProgram, tessControlShader);};
-    if(tessControlShader){glAttachShader(shaderProgram, tessControlShader);};
+    PendingBuild build;
+    build.sourceHash = hashSources(sources);
+    build.program = glCreateProgram();
     
-    //link the individual shaders to a shader program
-    glLinkProgram(shaderProgram);
-    glGetProgramiv(shaderProgram, GL_LINK_STATUS, &success);
+    //a cached binary of the same sources skips compiling and linking completely
+    if(ShaderCache::load(build.program, build.sourceHash)){
+        build.fromCache = true;
+        pendingBuild = std::move(build);
+        return;
+    }
+    
+    //the rejected binary could leave the program in any state, so start over
+    glDeleteProgram(build.program);
+    build.program = glCreateProgram();
+    
+    //the binary is needed afterwards for the shader cache
+    glProgramParameteri(build.program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+    
+    //with parallel compilation these calls return right away, the status is only checked when finishing
+    for(const auto& source : sources){
+        auto shader = compileShader(source.code, source.type);
+        glAttachShader(build.program, shader);
+        build.shaders.emplace_back(shader);
+    }
+    glLinkProgram(build.program);
+    
+    pendingBuild = std::move(build);
+}
+
+bool sakurajin::Shader::isBuildDone() const {
+    if(!pendingBuild || pendingBuild->fromCache || !hasParallelCompile()){
+        return true;
+    }
+    
+    int done = GL_FALSE;
+    glGetProgramiv(pendingBuild->program, GL_COMPLETION_STATUS_KHR, &done);
+    return done == GL_TRUE;
+}
+
+void sakurajin::Shader::finishBuild() {
+    if(!pendingBuild){
+        return;
+    }
+    
+    int success = GL_FALSE;
+    glGetProgramiv(pendingBuild->program, GL_LINK_STATUS, &success);
     if (success != GL_TRUE) {
-        char infoLog[512];
-        glGetProgramInfoLog(shaderProgram, 512, NULL, infoLog);
-        
-        glDeleteShader(vertexShader);
-        glDeleteShader(fragmentShader);
-        glDeleteShader(geometryShader);
-        glDeleteShader(computeShader);
-        glDeleteShader(tessControlShader);
-        glDeleteShader(tessEvalShader);
+        //a compile error is easier to read than the link error it causes
+        std::string error;
+        for(auto shader : pendingBuild->shaders){
+            int compiled = GL_FALSE;
+            glGetShaderiv(shader, GL_COMPILE_STATUS, &compiled);
+            if(compiled != GL_TRUE){
+                char infoLog[512];
+                glGetShaderInfoLog(shader, 512, NULL, infoLog);
+                error.append("could not compile shader: ").append(infoLog);
+            }
+        }
+        if(error.empty()){
+            char infoLog[512];
+            glGetProgramInfoLog(pendingBuild->program, 512, NULL, infoLog);
+            error.append("could not link shader program: ").append(infoLog);
+        }
         
-        shaderProgram = 0;
-        throw std::runtime_error(std::string{"could not link shader program: "}.append(infoLog));
+        discardPendingBuild();
+        throw std::runtime_error(error);
     }
     
     // delete the shaders as they're linked into our program now and no longer necessery
-    glDeleteShader(vertexShader);
-    glDeleteShader(fragmentShader);
-    glDeleteShader(geometryShader);
-    glDeleteShader(computeShader);
-    glDeleteShader(tessControlShader);
-    glDeleteShader(tessEvalShader);
+    for(auto shader : pendingBuild->shaders){
+        glDetachShader(pendingBuild->program, shader);
+        glDeleteShader(shader);
+    }
+    
+    if(!pendingBuild->fromCache){
+        ShaderCache::store(pendingBuild->program, pendingBuild->sourceHash);
+    }
+    
+    //swap in the new program, everything using this shader continues with it
+    if(shaderProgram){
+        glDeleteProgram(shaderProgram);
+    }
+    shaderProgram = pendingBuild->program;
+    pendingBuild.reset();
     
-    return 0;
+    queryProgramInfo();
+}
+
+bool sakurajin::Shader::pollBuild() {
+    if(!pendingBuild || !isBuildDone()){
+        return false;
+    }
+    
+    finishBuild();
+    return true;
+}
+
+bool sakurajin::Shader::isBuilding() const {
+    return pendingBuild.has_value();
+}
+
+bool sakurajin::Shader::isReady() const {
+    return shaderProgram != 0;
+}
+
+const sakurajin::Shader_configuration& sakurajin::Shader::getConfiguration() const {
+    return shader_config;
 }
 
 std::string sakurajin::Shader::loadFile ( std::filesystem::path location ) {
+    //the file on disk is only used if overriding the embedded shaders is allowed
+    if(!EmbeddedShaders::allowsOverride() || !std::filesystem::exists(location)){
+        auto embedded = EmbeddedShaders::find(location);
+        if(!embedded){
+            throw std::runtime_error("Shader file " + location.string() + " is neither embedded nor on disk");
+        }
+        return std::string{*embedded};
+    }
+    
     std::string shaderCode;
     std::ifstream ShaderFile;
     // ensure ifstream objects can throw exceptions:
@@ -287,25 +603,13 @@ std::string sakurajin::Shader::loadFile ( std::filesystem::path location ) {
     return shaderCode;
 }
 
-int sakurajin::Shader::compileShader( std::string code, unsigned int& shaderLoc, int shaderType ) {
-    // compile the shader and return the location of the result
-    int success;
-
+unsigned int sakurajin::Shader::compileShader( const std::string& code, int shaderType ) {
+    // start compiling the shader, errors are checked once the program is linked
     auto shaderCode = code.c_str();
 
     auto shader = glCreateShader(shaderType);
     glShaderSource(shader, 1, &shaderCode, NULL);
     glCompileShader(shader);
 
-    // print compile errors if anything went wrong
-    glGetShaderiv(shader, GL_COMPILE_STATUS, &success);
-    if (success != GL_TRUE) {
-        char infoLog[512];
-        glGetShaderInfoLog(shader, 512, NULL, infoLog);
-        throw std::runtime_error(std::string{"could not compile shader: "}.append(shaderCode).append(";reason: ").append(infoLog));
-    };
-
-    shaderLoc = shader;
-    return 0;
+    return shader;
 }
-
@@ -0,0 +1,178 @@
+#include "shader_cache.hpp"
+
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+namespace{
+    //increase this if the layout of the cache files changes
+    constexpr uint32_t cacheMagic = 0x53435331; //"SCS1"
+
+    template<class T>
+    void writeValue(std::ofstream& file, const T& value){
+        file.write(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+    template<class T>
+    bool readValue(std::ifstream& file, T& value){
+        return static_cast<bool>(file.read(reinterpret_cast<char*>(&value), sizeof(T)));
+    }
+
+    //the bytes after the read position, a length field larger than that is a damaged file
+    uint64_t remainingBytes(std::ifstream& file, uint64_t fileSize){
+        auto position = file.tellg();
+        if(position < 0 || static_cast<uint64_t>(position) > fileSize){
+            return 0;
+        }
+        return fileSize - static_cast<uint64_t>(position);
+    }
+
+    //stores from other threads and instances each write their own temporary file
+    std::atomic<uint64_t> temporaryCounter{0};
+}
+
+uint64_t sakurajin::ShaderCache::hash ( const void* data, size_t size, uint64_t seed ) {
+    auto bytes = static_cast<const uint8_t*>(data);
+    for(size_t i = 0; i < size; i++){
+        seed ^= bytes[i];
+        seed *= 0x100000001b3ull;
+    }
+    return seed;
+}
+
+std::string sakurajin::ShaderCache::getDriverString() {
+    auto glString = [](GLenum name){
+        auto value = glGetString(name);
+        return value ? std::string{reinterpret_cast<const char*>(value)} : std::string{};
+    };
+    return glString(GL_VENDOR) + "|" + glString(GL_RENDERER) + "|" + glString(GL_VERSION);
+}
+
+std::filesystem::path sakurajin::ShaderCache::getCacheDirectory() {
+    if(auto cacheHome = std::getenv("XDG_CACHE_HOME"); cacheHome && *cacheHome){
+        return std::filesystem::path{cacheHome} / "video-app" / "shaders";
+    }
+    if(auto home = std::getenv("HOME"); home && *home){
+        return std::filesystem::path{home} / ".cache" / "video-app" / "shaders";
+    }
+    return {};
+}
+
+std::filesystem::path sakurajin::ShaderCache::getCacheFile ( uint64_t sourceHash ) {
+    auto directory = getCacheDirectory();
+    if(directory.empty()){
+        return {};
+    }
+
+    char name[32];
+    snprintf(name, sizeof(name), "%016llx.bin", static_cast<unsigned long long>(sourceHash));
+    return directory / name;
+}
+
+bool sakurajin::ShaderCache::load ( unsigned int program, uint64_t sourceHash ) {
+    auto location = getCacheFile(sourceHash);
+    if(location.empty()){
+        return false;
+    }
+
+    std::error_code error;
+    const auto fileSize = std::filesystem::file_size(location, error);
+    if(error){
+        return false;
+    }
+
+    std::ifstream file{location, std::ios::binary};
+    if(!file){
+        return false;
+    }
+
+    //a binary is only valid for the exact driver that created it
+    uint32_t magic = 0, driverLength = 0, binaryLength = 0;
+    GLenum format = 0;
+    if(!readValue(file, magic) || magic != cacheMagic || !readValue(file, driverLength)){
+        return false;
+    }
+    if(driverLength > remainingBytes(file, fileSize)){
+        return false;
+    }
+
+    std::string driver(driverLength, '\0');
+    if(!file.read(driver.data(), driverLength) || driver != getDriverString()){
+        return false;
+    }
+
+    if(!readValue(file, format) || !readValue(file, binaryLength)){
+        return false;
+    }
+    if(binaryLength == 0 || binaryLength > remainingBytes(file, fileSize)){
+        return false;
+    }
+
+    std::vector<char> binary(binaryLength);
+    if(!file.read(binary.data(), binaryLength)){
+        return false;
+    }
+
+    //the driver can still reject the binary, e.g. after an update that kept the version string
+    glProgramBinary(program, format, binary.data(), binaryLength);
+    int success = GL_FALSE;
+    glGetProgramiv(program, GL_LINK_STATUS, &success);
+    return success == GL_TRUE;
+}
+
+void sakurajin::ShaderCache::store ( unsigned int program, uint64_t sourceHash ) {
+    auto location = getCacheFile(sourceHash);
+    if(location.empty()){
+        return;
+    }
+
+    int formatCount = 0;
+    glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &formatCount);
+    if(formatCount == 0){
+        return;
+    }
+
+    int binaryLength = 0;
+    glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &binaryLength);
+    if(binaryLength <= 0){
+        return;
+    }
+
+    std::vector<char> binary(binaryLength);
+    GLenum format = 0;
+    glGetProgramBinary(program, binaryLength, nullptr, &format, binary.data());
+
+    //write to a temporary file first, so a second instance never reads half a binary
+    std::error_code error;
+    std::filesystem::create_directories(location.parent_path(), error);
+    auto temporary = location;
+    temporary += "." + std::to_string(getpid()) + "." + std::to_string(temporaryCounter++) + ".tmp";
+
+    {
+        std::ofstream file{temporary, std::ios::binary | std::ios::trunc};
+        auto driver = getDriverString();
+        writeValue(file, cacheMagic);
+        writeValue(file, static_cast<uint32_t>(driver.size()));
+        file.write(driver.data(), driver.size());
+        writeValue(file, format);
+        writeValue(file, static_cast<uint32_t>(binaryLength));
+        file.write(binary.data(), binaryLength);
+
+        if(!file){
+            std::cerr << "could not write the shader cache file " << temporary << std::endl;
+            std::filesystem::remove(temporary, error);
+            return;
+        }
+    }
+
+    std::filesystem::rename(temporary, location, error);
+    if(error){
+        std::cerr << "could not write the shader cache file " << location << ": " << error.message() << std::endl;
+        std::filesystem::remove(temporary, error);
+    }
+}
@@ -0,0 +1,188 @@
+#include "shader_manager.hpp"
+#include "embedded_shaders.hpp"
+
+#include <algorithm>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+sakurajin::ShaderManager::ShaderManager ( bool hotReload ) {
+    //let the driver use as many threads as it wants for compiling
+    if(Shader::hasParallelCompile()){
+        using MaxThreadsFunction = void (APIENTRYP)(GLuint count);
+        auto maxShaderCompilerThreads = reinterpret_cast<MaxThreadsFunction>(SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsKHR"));
+        if(!maxShaderCompilerThreads){
+            maxShaderCompilerThreads = reinterpret_cast<MaxThreadsFunction>(SDL_GL_GetProcAddress("glMaxShaderCompilerThreadsARB"));
+        }
+        if(maxShaderCompilerThreads){
+            maxShaderCompilerThreads(0xFFFFFFFF);
+        }
+    }
+
+    //the files on disk are ignored if they can't override the embedded shaders
+    if(hotReload && EmbeddedShaders::allowsOverride()){
+        inotifyFd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        if(inotifyFd < 0){
+            std::cerr << "could not watch the shader files, hot reload is disabled" << std::endl;
+        }
+    }
+}
+
+sakurajin::ShaderManager::~ShaderManager() {
+    if(inotifyFd >= 0){
+        close(inotifyFd);
+    }
+}
+
+std::shared_ptr<sakurajin::Shader> sakurajin::ShaderManager::load ( const Shader_configuration& config ) {
+    ShaderEntry entry;
+    try{
+        entry.shader = std::make_shared<Shader>(config, Shader::BuildMode::deferred);
+    }catch(...){
+        std::throw_with_nested(std::runtime_error("could not load shader"));
+    }
+
+    watchFiles(entry);
+    shaders.emplace_back(entry);
+    return entry.shader;
+}
+
+std::shared_ptr<sakurajin::Shader> sakurajin::ShaderManager::load ( const std::filesystem::path& vertLoc, const std::filesystem::path& fragLoc ) {
+    return load(Shader_configuration{vertLoc, fragLoc});
+}
+
+void sakurajin::ShaderManager::watchFiles ( ShaderEntry& entry ) {
+    entry.files = entry.shader->getConfiguration().getStageLocations();
+    if(inotifyFd < 0){
+        return;
+    }
+
+    //the events contain the path of the watched directory, so the files need the same form
+    std::error_code error;
+    for(auto& file : entry.files){
+        file = std::filesystem::weakly_canonical(file, error);
+    }
+
+    //editors often write a new file and rename it, so the directories are watched instead of the files
+    for(const auto& file : entry.files){
+        auto directory = file.parent_path();
+        bool watched = std::any_of(watchedDirectories.begin(), watchedDirectories.end(), [&](const auto& watch){
+            return watch.second == directory;
+        });
+        if(watched){
+            continue;
+        }
+
+        int watch = inotify_add_watch(inotifyFd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE);
+        if(watch < 0){
+            std::cerr << "could not watch " << directory << " for shader changes" << std::endl;
+            continue;
+        }
+        watchedDirectories[watch] = directory;
+    }
+}
+
+std::vector<std::filesystem::path> sakurajin::ShaderManager::readChangedFiles() {
+    std::vector<std::filesystem::path> changed;
+    if(inotifyFd < 0){
+        return changed;
+    }
+
+    alignas(inotify_event) char buffer[4096];
+    while(true){
+        auto length = read(inotifyFd, buffer, sizeof(buffer));
+        if(length <= 0){
+            break;
+        }
+
+        for(char* position = buffer; position < buffer + length;){
+            auto event = reinterpret_cast<const inotify_event*>(position);
+            position += sizeof(inotify_event) + event->len;
+
+            auto directory = watchedDirectories.find(event->wd);
+            if(event->len == 0 || directory == watchedDirectories.end()){
+                continue;
+            }
+
+            auto file = directory->second / event->name;
+            if(std::find(changed.begin(), changed.end(), file) == changed.end()){
+                changed.emplace_back(file);
+            }
+        }
+    }
+
+    return changed;
+}
+
+bool sakurajin::ShaderManager::update() {
+    //restart the build of every shader that uses a changed file
+    auto changedFiles = readChangedFiles();
+    for(auto& entry : shaders){
+        bool changed = std::any_of(entry.files.begin(), entry.files.end(), [&](const std::filesystem::path& file){
+            return std::find(changedFiles.begin(), changedFiles.end(), file) != changedFiles.end();
+        });
+        if(!changed){
+            continue;
+        }
+
+        try{
+            entry.shader->startBuild();
+        }catch(const std::exception& e){
+            lastError = e.what();
+            Helper::print_exception(e);
+        }
+    }
+
+    bool replaced = false;
+    for(auto& entry : shaders){
+        bool wasReady = entry.shader->isReady();
+        try{
+            if(entry.shader->pollBuild()){
+                replaced = true;
+                if(wasReady){
+                    reloadCount++;
+                    lastError.clear();
+                    std::cout << "reloaded shader " << entry.files.back() << std::endl;
+                }
+            }
+        }catch(const std::exception& e){
+            //without a working program the application can't continue
+            if(!wasReady){
+                std::throw_with_nested(std::runtime_error("could not build shader " + entry.files.back().string()));
+            }
+            lastError = e.what();
+            Helper::print_exception(e);
+        }
+    }
+
+    return replaced;
+}
+
+void sakurajin::ShaderManager::finishAll() {
+    for(auto& entry : shaders){
+        try{
+            entry.shader->finishBuild();
+        }catch(...){
+            std::throw_with_nested(std::runtime_error("could not build shader " + entry.files.back().string()));
+        }
+    }
+}
+
+bool sakurajin::ShaderManager::isReady() const {
+    return std::all_of(shaders.begin(), shaders.end(), [](const ShaderEntry& entry){
+        return entry.shader->isReady();
+    });
+}
+
+size_t sakurajin::ShaderManager::getBuildingCount() const {
+    return std::count_if(shaders.begin(), shaders.end(), [](const ShaderEntry& entry){
+        return entry.shader->isBuilding();
+    });
+}
+
+uint64_t sakurajin::ShaderManager::getReloadCount() const {
+    return reloadCount;
+}
+
+const std::string& sakurajin::ShaderManager::getLastError() const {
+    return lastError;
+}
@@ -0,0 +1,175 @@
+#include "shader_variants.hpp"
+
+extern "C" {
+#include <libavutil/pixdesc.h>
+}
+
+namespace{
+    //the bit layout of a packed key
+    constexpr uint32_t pixelFormatShift = 0;
+    constexpr uint32_t colorMatrixShift = 2;
+    constexpr uint32_t colorRangeShift = 4;
+    constexpr uint32_t alphaModeShift = 5;
+    constexpr uint32_t gradeShift = 7;
+    constexpr uint32_t twoBits = 0x3;
+    constexpr uint32_t oneBit = 0x1;
+}
+
+sakurajin::ShaderVariantKey sakurajin::ShaderVariantKey::fromStream ( AVPixelFormat format, AVColorSpace colorSpace, AVColorRange range, int height ) {
+    ShaderVariantKey key;
+
+    switch(colorSpace){
+        case AVCOL_SPC_BT470BG:
+        case AVCOL_SPC_SMPTE170M:
+            key.colorMatrix = ColorMatrix::bt601;
+            break;
+        case AVCOL_SPC_BT2020_NCL:
+            key.colorMatrix = ColorMatrix::bt2020;
+            break;
+        case AVCOL_SPC_UNSPECIFIED:
+            //untagged SD video is usually BT.601, everything larger BT.709
+            key.colorMatrix = height <= 576 ? ColorMatrix::bt601 : ColorMatrix::bt709;
+            break;
+        default:
+            key.colorMatrix = ColorMatrix::bt709;
+            break;
+    }
+
+    //the JPEG formats are full range even if the stream doesn't say so
+    bool fullRange = range == AVCOL_RANGE_JPEG ||
+        format == AV_PIX_FMT_YUVJ420P ||
+        format == AV_PIX_FMT_YUVJ422P ||
+        format == AV_PIX_FMT_YUVJ444P ||
+        format == AV_PIX_FMT_YUVJ440P;
+    key.colorRange = fullRange ? ColorRange::full : ColorRange::limited;
+
+    //video alpha is stored unassociated
+    auto descriptor = av_pix_fmt_desc_get(format);
+    bool hasAlpha = descriptor && (descriptor->flags & AV_PIX_FMT_FLAG_ALPHA);
+    key.alphaMode = hasAlpha ? AlphaMode::straight : AlphaMode::opaque;
+
+    return key;
+}
+
+uint32_t sakurajin::ShaderVariantKey::pack() const {
+    uint32_t packed = static_cast<uint32_t>(pixelFormat) << pixelFormatShift;
+    packed |= static_cast<uint32_t>(alphaMode) << alphaModeShift;
+    packed |= static_cast<uint32_t>(grade) << gradeShift;
+
+    //RGBA data was already converted, the YUV description doesn't change its shader
+    if(pixelFormat != PixelFormat::rgba){
+        packed |= static_cast<uint32_t>(colorMatrix) << colorMatrixShift;
+        packed |= static_cast<uint32_t>(colorRange) << colorRangeShift;
+    }
+
+    return packed;
+}
+
+sakurajin::ShaderVariantKey sakurajin::ShaderVariantKey::unpack ( uint32_t packed ) {
+    ShaderVariantKey key;
+    key.pixelFormat = static_cast<PixelFormat>((packed >> pixelFormatShift) & twoBits);
+    key.colorMatrix = static_cast<ColorMatrix>((packed >> colorMatrixShift) & twoBits);
+    key.colorRange = static_cast<ColorRange>((packed >> colorRangeShift) & oneBit);
+    key.alphaMode = static_cast<AlphaMode>((packed >> alphaModeShift) & twoBits);
+    key.grade = (packed >> gradeShift) & oneBit;
+    return key;
+}
+
+sakurajin::Shader_configuration::Defines sakurajin::ShaderVariantKey::getDefines() const {
+    Shader_configuration::Defines defines;
+
+    switch(pixelFormat){
+        case PixelFormat::rgba:
+            defines.emplace_back("PIXEL_FORMAT_RGBA", "1");
+            break;
+        case PixelFormat::yuv420p:
+            defines.emplace_back("PIXEL_FORMAT_YUV420P", "1");
+            break;
+        case PixelFormat::nv12:
+            defines.emplace_back("PIXEL_FORMAT_NV12", "1");
+            break;
+    }
+
+    if(pixelFormat != PixelFormat::rgba){
+        switch(colorMatrix){
+            case ColorMatrix::bt601:
+                defines.emplace_back("COLOR_MATRIX_BT601", "1");
+                break;
+            case ColorMatrix::bt709:
+                defines.emplace_back("COLOR_MATRIX_BT709", "1");
+                break;
+            case ColorMatrix::bt2020:
+                defines.emplace_back("COLOR_MATRIX_BT2020", "1");
+                break;
+        }
+        defines.emplace_back(colorRange == ColorRange::full ? "COLOR_RANGE_FULL" : "COLOR_RANGE_LIMITED", "1");
+    }
+
+    switch(alphaMode){
+        case AlphaMode::opaque:
+            defines.emplace_back("ALPHA_OPAQUE", "1");
+            break;
+        case AlphaMode::straight:
+            defines.emplace_back("ALPHA_STRAIGHT", "1");
+            break;
+        case AlphaMode::premultiplied:
+            defines.emplace_back("ALPHA_PREMULTIPLIED", "1");
+            break;
+    }
+
+    if(grade){
+        defines.emplace_back("TILE_GRADE", "1");
+    }
+
+    return defines;
+}
+
+std::string sakurajin::ShaderVariantKey::describe() const {
+    std::string description;
+    for(const auto& define : getDefines()){
+        if(!description.empty()){
+            description += " ";
+        }
+        description += define.first;
+    }
+    return description;
+}
+
+sakurajin::ShaderVariants::ShaderVariants ( ShaderManager& _shaderManager, const Shader_configuration& _baseConfiguration, std::function<void(Shader&)> _setup ) :
+    shaderManager{_shaderManager},
+    baseConfiguration{_baseConfiguration},
+    setup{std::move(_setup)}
+    {}
+
+std::shared_ptr<sakurajin::Shader> sakurajin::ShaderVariants::get ( const ShaderVariantKey& key ) {
+    return get(key.pack());
+}
+
+std::shared_ptr<sakurajin::Shader> sakurajin::ShaderVariants::get ( uint32_t packedKey ) {
+    auto variant = variants.find(packedKey);
+    if(variant != variants.end()){
+        return variant->second;
+    }
+
+    auto configuration = baseConfiguration;
+    auto defines = ShaderVariantKey::unpack(packedKey).getDefines();
+    configuration.defines.insert(configuration.defines.end(), defines.begin(), defines.end());
+
+    std::shared_ptr<Shader> shader;
+    try{
+        shader = shaderManager.load(configuration);
+    }catch(...){
+        std::throw_with_nested(std::runtime_error("could not create the shader variant " + ShaderVariantKey::unpack(packedKey).describe()));
+    }
+
+    if(setup){
+        setup(*shader);
+    }
+
+    variants[packedKey] = shader;
+    return shader;
+}
+
+size_t sakurajin::ShaderVariants::getVariantCount() const {
+    return variants.size();
+}
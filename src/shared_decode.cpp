@@ -0,0 +1,106 @@
+#include "shared_decode.hpp"
+
+#include <algorithm>
+
+namespace{
+    const sakurajin::FrameView noFrame{};
+}
+
+size_t sakurajin::SharedDecode::findSource ( const std::vector<std::unique_ptr<VideoTile>>& tiles, const std::string& filename, int stream, bool reverse ) {
+    for(size_t i = 0; i < tiles.size(); i++){
+        if(tiles[i]->getFilename() == filename && tiles[i]->getStream() == stream && tiles[i]->isReverse() == reverse){
+            return i;
+        }
+    }
+    return noSource;
+}
+
+void sakurajin::SharedDecode::addMirror ( const Mirror& mirror ) {
+    MirrorState state;
+    state.mirror = mirror;
+    state.mirror.delay = std::clamp(mirror.delay, 0.0, maxDelay);
+    mirrors.emplace_back(std::move(state));
+}
+
+size_t sakurajin::SharedDecode::getMirrorCount() const {
+    return mirrors.size();
+}
+
+sakurajin::SharedDecode::Mirror& sakurajin::SharedDecode::getMirror ( size_t mirror ) {
+    return mirrors.at(mirror).mirror;
+}
+
+void sakurajin::SharedDecode::resolveSources ( const std::vector<std::unique_ptr<VideoTile>>& tiles ) {
+    //assign keeps the capacity, so this doesn't allocate once the tile count is stable
+    feedsMirror.assign(tiles.size(), 0);
+
+    for(auto& state : mirrors){
+        //a tile that was swapped to another clip loses its mirrors, they wait for a new source
+        const auto& mirror = state.mirror;
+        if(state.source >= tiles.size() || tiles[state.source]->getFilename() != mirror.filename || tiles[state.source]->getStream() != mirror.stream || tiles[state.source]->isReverse() != mirror.reverse){
+            state.source = findSource(tiles, mirror.filename, mirror.stream, mirror.reverse);
+            state.uploaded = false;
+        }
+        if(state.source == noSource){
+            continue;
+        }
+
+        state.mirror.delay = std::clamp(state.mirror.delay, 0.0, maxDelay);
+        if(state.mirror.shown){
+            feedsMirror[state.source] = 1;
+        }
+    }
+
+    //the history has to reach back to the mirror with the largest delay
+    for(size_t i = 0; i < tiles.size(); i++){
+        double history = 0.0;
+        for(const auto& state : mirrors){
+            if(state.source == i){
+                history = std::max(history, state.mirror.delay);
+            }
+        }
+        tiles[i]->setHistoryLength(history, maxHistoryBytes);
+    }
+}
+
+size_t sakurajin::SharedDecode::getSource ( size_t mirror ) const {
+    return mirrors.at(mirror).source;
+}
+
+bool sakurajin::SharedDecode::isFeedingMirror ( size_t tile ) const {
+    return tile < feedsMirror.size() && feedsMirror[tile] != 0;
+}
+
+const sakurajin::FrameView& sakurajin::SharedDecode::getDelayedFrame ( size_t mirror, const std::vector<std::unique_ptr<VideoTile>>& tiles ) const {
+    const auto& state = mirrors.at(mirror);
+    if(state.source == noSource || state.mirror.delay <= 0.0){
+        return noFrame;
+    }
+
+    double frameTime;
+    return tiles[state.source]->getDelayedFrame(state.mirror.delay, frameTime);
+}
+
+bool sakurajin::SharedDecode::takeUpload ( size_t mirror, const std::vector<std::unique_ptr<VideoTile>>& tiles ) {
+    auto& state = mirrors.at(mirror);
+    if(state.source == noSource || state.mirror.delay <= 0.0){
+        return false;
+    }
+
+    //the pooled buffers are reused, so the frames are told apart by their time
+    double frameTime;
+    const auto& frame = tiles[state.source]->getDelayedFrame(state.mirror.delay, frameTime);
+    if(!frame.isValid() || (state.uploaded && frameTime == state.uploadedTime)){
+        return false;
+    }
+
+    state.uploaded = true;
+    state.uploadedTime = frameTime;
+    return true;
+}
+
+void sakurajin::SharedDecode::invalidateUploads() {
+    for(auto& state : mirrors){
+        state.uploaded = false;
+    }
+}
@@ -0,0 +1,156 @@
+#include "stream_demuxer.hpp"
+
+#include <stdexcept>
+
+sakurajin::StreamDemuxer::StreamDemuxer ( const std::string& _filename, const MediaResources& _resources, size_t _maxQueuedBytes ) : filename{_filename}, resources{_resources}, maxQueuedBytes{_maxQueuedBytes} {
+    //the file is read the same way as by a single reader, only the decoders are split up
+    preloadedClip = resources.loadClip(filename);
+    resources.configureReader(&input, preloadedClip.get());
+    if(!video_reader_open_input(&input, filename.c_str())){
+        video_reader_close(&input);
+        throw std::runtime_error("could not open video file " + filename);
+    }
+
+    auto formatContext = input.av_format_ctx;
+    queues.resize(formatContext->nb_streams);
+    for(unsigned int i = 0; i < formatContext->nb_streams; i++){
+        if(video_reader_is_video_stream(formatContext->streams[i])){
+            videoStreams.emplace_back(static_cast<int>(i));
+        }
+    }
+
+    if(videoStreams.empty()){
+        video_reader_close(&input);
+        throw std::runtime_error("could not find a video stream in " + filename);
+    }
+
+    demuxPacket = resources.packets.acquirePacket();
+    if(!demuxPacket){
+        video_reader_close(&input);
+        throw std::runtime_error("could not allocate the demuxer packet");
+    }
+}
+
+sakurajin::StreamDemuxer::~StreamDemuxer() {
+    for(auto& queue : queues){
+        clearQueue(queue);
+    }
+    resources.packets.release(demuxPacket);
+    video_reader_close(&input);
+}
+
+const std::string& sakurajin::StreamDemuxer::getFilename() const {
+    return filename;
+}
+
+std::shared_ptr<sakurajin::PreloadedClip> sakurajin::StreamDemuxer::getPreloadedClip() const {
+    return preloadedClip;
+}
+
+size_t sakurajin::StreamDemuxer::getVideoStreamCount() const {
+    return videoStreams.size();
+}
+
+AVFormatContext* sakurajin::StreamDemuxer::getFormatContext() const {
+    return input.av_format_ctx;
+}
+
+void sakurajin::StreamDemuxer::addConsumer ( int streamIndex ) {
+    std::scoped_lock lock{demuxMutex};
+    queues.at(streamIndex).consumers++;
+}
+
+void sakurajin::StreamDemuxer::removeConsumer ( int streamIndex ) {
+    std::scoped_lock lock{demuxMutex};
+    auto& queue = queues.at(streamIndex);
+    queue.consumers--;
+
+    //nobody reads the packets anymore, so they are given back right away
+    if(queue.consumers <= 0){
+        clearQueue(queue);
+        queue.resync = false;
+    }
+}
+
+void sakurajin::StreamDemuxer::clearQueue ( StreamQueue& queue ) {
+    for(auto& packet : queue.packets){
+        resources.packets.release(packet);
+    }
+    queue.packets.clear();
+    queue.bytes = 0;
+}
+
+bool sakurajin::StreamDemuxer::waitsForKeyframe ( StreamQueue& queue, const AVPacket* packet ) {
+    if(queue.resync && (packet->flags & AV_PKT_FLAG_KEY)){
+        queue.resync = false;
+    }
+    return queue.resync;
+}
+
+int sakurajin::StreamDemuxer::readPacket ( int streamIndex, AVPacket* packet ) {
+    std::scoped_lock lock{demuxMutex};
+
+    auto& queue = queues.at(streamIndex);
+    if(!queue.packets.empty()){
+        auto queued = queue.packets.front();
+        queue.packets.pop_front();
+        queue.bytes -= queued->size;
+        av_packet_move_ref(packet, queued);
+        resources.packets.release(queued);
+        return 0;
+    }
+
+    while(true){
+        int response = av_read_frame(input.av_format_ctx, demuxPacket);
+        if(response < 0){
+            return response;
+        }
+
+        const int packetStream = demuxPacket->stream_index;
+        if(packetStream < 0 || packetStream >= static_cast<int>(queues.size())){
+            av_packet_unref(demuxPacket);
+            continue;
+        }
+
+        auto& packetQueue = queues[packetStream];
+        if(packetStream == streamIndex && !waitsForKeyframe(packetQueue, demuxPacket)){
+            av_packet_move_ref(packet, demuxPacket);
+            return 0;
+        }
+
+        //the packet is kept for the reader of its stream, the pooled packet only takes the reference.
+        //A reader that is too far behind loses its queue and continues at the next keyframe,
+        //so the other readers never wait for it and the memory stays bounded.
+        if(packetStream != streamIndex && packetQueue.consumers > 0 && !waitsForKeyframe(packetQueue, demuxPacket)){
+            if(packetQueue.bytes + demuxPacket->size > maxQueuedBytes){
+                clearQueue(packetQueue);
+                packetQueue.resync = !(demuxPacket->flags & AV_PKT_FLAG_KEY);
+            }
+
+            if(!packetQueue.resync){
+                auto queued = resources.packets.acquirePacket();
+                if(queued){
+                    packetQueue.bytes += demuxPacket->size;
+                    av_packet_move_ref(queued, demuxPacket);
+                    packetQueue.packets.emplace_back(queued);
+                    continue;
+                }
+
+                //without a pooled packet this one is lost, the reader can only continue at a keyframe
+                clearQueue(packetQueue);
+                packetQueue.resync = true;
+            }
+        }
+        av_packet_unref(demuxPacket);
+    }
+}
+
+size_t sakurajin::StreamDemuxer::getQueuedPacketCount() {
+    std::scoped_lock lock{demuxMutex};
+
+    size_t count = 0;
+    for(const auto& queue : queues){
+        count += queue.packets.size();
+    }
+    return count;
+}
@@ -0,0 +1,49 @@
+#include "uniform_buffer.hpp"
+
+#include <cstring>
+#include <stdexcept>
+
+sakurajin::UniformBuffer::UniformBuffer ( size_t size ) : content(size, 0) {
+    glGenBuffers(1, &buffer);
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferData(GL_UNIFORM_BUFFER, size, content.data(), GL_DYNAMIC_DRAW);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+}
+
+sakurajin::UniformBuffer::~UniformBuffer() {
+    glDeleteBuffers(1, &buffer);
+}
+
+bool sakurajin::UniformBuffer::update ( const void* data, size_t size, size_t offset ) {
+    if(offset + size > content.size()){
+        throw std::out_of_range("uniform buffer update is larger than the buffer");
+    }
+
+    if(std::memcmp(content.data() + offset, data, size) == 0){
+        return false;
+    }
+    std::memcpy(content.data() + offset, data, size);
+
+    glBindBuffer(GL_UNIFORM_BUFFER, buffer);
+    glBufferSubData(GL_UNIFORM_BUFFER, offset, size, data);
+    glBindBuffer(GL_UNIFORM_BUFFER, 0);
+
+    uploadCount++;
+    return true;
+}
+
+void sakurajin::UniformBuffer::bind ( unsigned int binding ) const {
+    glBindBufferBase(GL_UNIFORM_BUFFER, binding, buffer);
+}
+
+unsigned int sakurajin::UniformBuffer::getBuffer() const {
+    return buffer;
+}
+
+size_t sakurajin::UniformBuffer::getSize() const {
+    return content.size();
+}
+
+uint64_t sakurajin::UniformBuffer::getUploadCount() const {
+    return uploadCount;
+}
@@ -1,5 +1,32 @@
 #include "video_reader.hpp"
 
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "allocation_counter.hpp"
+#include "io_scheduler.hpp"
+#include "packet_pool.hpp"
+#include "stream_demuxer.hpp"
+
+extern "C" {
+#include <libavutil/imgutils.h>
+#include <libavutil/pixdesc.h>
+}
+
+// Rows of the pooled decoder buffers start at this alignment, which is enough
+// for every SIMD width of the decoders and for the texture upload.
+static const int FRAME_ROW_ALIGNMENT = 64;
+
+// Size of the buffer the demuxer reads mapped and scheduled files through
+static const int CUSTOM_IO_BUFFER_SIZE = 64 * 1024;
+
+// The kernel is asked to read this far ahead of the demuxer and around seek targets
+static const size_t MAPPED_READAHEAD = 8 * 1024 * 1024;
+
 // av_err2str returns a temporary array. This doesn't work in gcc.
 // This function can be used as a replacement for av_err2str.
 static const char* av_make_error(int errnum) {
@@ -20,17 +47,367 @@ static AVPixelFormat correct_for_deprecated_pixel_format(AVPixelFormat pix_fmt)
     }
 }
 
-bool video_reader_open(VideoReaderState* state, const char* filename) {
+// The YUV matrix swscale converts with. It has to match ShaderVariantKey::fromStream,
+// so a stream without a colour space is BT.601 up to SD height and BT.709 above.
+static int sws_colorspace_of(const VideoReaderState* state) {
+    switch (state->color_space) {
+        case AVCOL_SPC_BT470BG:
+        case AVCOL_SPC_SMPTE170M:   return SWS_CS_ITU601;
+        case AVCOL_SPC_BT2020_NCL:  return SWS_CS_BT2020;
+        case AVCOL_SPC_UNSPECIFIED: return state->height <= 576 ? SWS_CS_ITU601 : SWS_CS_ITU709;
+        default:                    return SWS_CS_ITU709;
+    }
+}
+
+// Level of detail steps as a fraction of the native size. The output size is
+// snapped to these steps so resizing a tile doesn't rebuild the scaler every frame.
+static const int lod_levels[][2] = {
+    {1, 1}, {3, 4}, {1, 2}, {3, 8}, {1, 4}, {3, 16}, {1, 8}
+};
+
+// Hands the decoder buffers from our own pool, so a decoded frame can be kept by
+// reference and uploaded straight from the decoder output. All planes of a frame
+// are in one buffer with aligned rows. Every other format uses the default buffers.
+static int get_frame_buffer(AVCodecContext* av_codec_ctx, AVFrame* frame, int flags) {
+    auto state = static_cast<VideoReaderState*>(av_codec_ctx->opaque);
+    auto format = static_cast<AVPixelFormat>(frame->format);
+    if (!(av_codec_ctx->codec->capabilities & AV_CODEC_CAP_DR1) || !video_reader_is_native_format(format)) {
+        return avcodec_default_get_buffer2(av_codec_ctx, frame, flags);
+    }
+
+    // The decoder can write past the visible size, so the buffers use the aligned size
+    int width = frame->width;
+    int height = frame->height;
+    int linesize_align[AV_NUM_DATA_POINTERS];
+    avcodec_align_dimensions2(av_codec_ctx, &width, &height, linesize_align);
+
+    int linesizes[4];
+    if (av_image_fill_linesizes(linesizes, format, width) < 0) {
+        return avcodec_default_get_buffer2(av_codec_ctx, frame, flags);
+    }
+
+    ptrdiff_t aligned_linesizes[4];
+    for (int i = 0; i < 4; ++i) {
+        int alignment = std::max(FRAME_ROW_ALIGNMENT, linesize_align[i]);
+        aligned_linesizes[i] = FFALIGN(linesizes[i], alignment);
+    }
+
+    size_t plane_sizes[4];
+    if (av_image_fill_plane_sizes(plane_sizes, format, height, aligned_linesizes) < 0) {
+        return avcodec_default_get_buffer2(av_codec_ctx, frame, flags);
+    }
+
+    // Some SIMD code reads a little past the last row
+    size_t buffer_size = FRAME_ROW_ALIGNMENT;
+    for (int i = 0; i < 4; ++i) {
+        buffer_size += plane_sizes[i];
+    }
+
+    {
+        std::scoped_lock lock{state->frame_pool_mutex};
+
+        // Frames that still use the old pool keep it alive until they are released
+        if (!state->frame_pool || state->frame_pool_size != buffer_size) {
+            av_buffer_pool_uninit(&state->frame_pool);
+            state->frame_pool = av_buffer_pool_init(buffer_size, NULL);
+            state->frame_pool_size = buffer_size;
+        }
+        frame->buf[0] = state->frame_pool ? av_buffer_pool_get(state->frame_pool) : NULL;
+    }
+    if (!frame->buf[0]) {
+        return AVERROR(ENOMEM);
+    }
+
+    uint8_t* plane = frame->buf[0]->data;
+    for (int i = 0; i < 4 && plane_sizes[i] > 0; ++i) {
+        frame->data[i] = plane;
+        frame->linesize[i] = aligned_linesizes[i];
+        plane += plane_sizes[i];
+    }
+    frame->extended_data = frame->data;
+
+    return 0;
+}
+
+// The demuxer allocates the payload of every packet itself and there is no way to
+// hand it our own buffers, so the allocation check leaves reading out.
+// A shared demuxer only hands out the packets of the stream of this reader.
+static int read_packet(VideoReaderState* state, AVPacket* av_packet) {
+    sakurajin::AllocationCounter::Pause pause;
+    if (state->demuxer) {
+        return state->demuxer->readPacket(state->video_stream_index, av_packet);
+    }
+    return av_read_frame(state->av_format_ctx, av_packet);
+}
+
+static bool is_aborted(const VideoReaderState* state) {
+    return state->abort_flag && state->abort_flag->load(std::memory_order_relaxed);
+}
+
+// Called by libavformat while it blocks in the default protocol
+static int check_abort(void* opaque) {
+    return is_aborted(static_cast<VideoReaderState*>(opaque)) ? 1 : 0;
+}
+
+// Ask the kernel to page in the mapped file from position on, madvise needs page aligned ranges
+static void advise_mapped_range(VideoReaderState* state, size_t position) {
+    static const size_t page_size = sysconf(_SC_PAGESIZE);
+
+    size_t start = position & ~(page_size - 1);
+    size_t end = std::min(position + MAPPED_READAHEAD, state->mapped_size);
+    if (start >= end) {
+        return;
+    }
+
+    madvise(const_cast<uint8_t*>(state->mapped_data) + start, end - start, MADV_WILLNEED);
+    state->mapped_advised_end = end;
+}
+
+static int read_mapped(void* opaque, uint8_t* buf, int buf_size) {
+    auto state = static_cast<VideoReaderState*>(opaque);
+    if (is_aborted(state)) {
+        return AVERROR_EXIT;
+    }
+    if (state->mapped_position >= state->mapped_size) {
+        return AVERROR_EOF;
+    }
+
+    // Keep the readahead in front of the demuxer, half a window before it runs out
+    if (state->mapped_file && state->mapped_advised_end < state->mapped_size && state->mapped_position + MAPPED_READAHEAD / 2 > state->mapped_advised_end) {
+        advise_mapped_range(state, state->mapped_position);
+    }
+
+    // libavformat parses out of its own buffer, so the mapped data is copied there
+    size_t size = std::min<size_t>(buf_size, state->mapped_size - state->mapped_position);
+    memcpy(buf, state->mapped_data + state->mapped_position, size);
+    state->mapped_position += size;
+    return static_cast<int>(size);
+}
+
+static int64_t seek_mapped(void* opaque, int64_t offset, int whence) {
+    auto state = static_cast<VideoReaderState*>(opaque);
+
+    int64_t position;
+    switch (whence & ~AVSEEK_FORCE) {
+        case AVSEEK_SIZE: return state->mapped_size;
+        case SEEK_SET: position = offset; break;
+        case SEEK_CUR: position = state->mapped_position + offset; break;
+        case SEEK_END: position = state->mapped_size + offset; break;
+        default: return AVERROR(EINVAL);
+    }
+    if (position < 0 || position > static_cast<int64_t>(state->mapped_size)) {
+        return AVERROR(EINVAL);
+    }
+
+    // A jump out of the readahead window pages in the target right away
+    state->mapped_position = position;
+    if (!state->mapped_file) {
+        return position;
+    }
+    size_t window_start = state->mapped_advised_end - std::min(state->mapped_advised_end, MAPPED_READAHEAD);
+    if (state->mapped_position < window_start || state->mapped_position + MAPPED_READAHEAD / 2 > state->mapped_advised_end) {
+        advise_mapped_range(state, state->mapped_position);
+    }
+    return position;
+}
+
+// Map a local file and give the demuxer a custom AVIOContext that reads from the
+// mapping. Every read is still copied from the page cache into the AVIO buffer,
+// the mapping only saves the read() syscall per buffer. Returns false if the input isn't a regular file that can be mapped, the
+// caller falls back to the default protocol then.
+static bool open_mapped_input(VideoReaderState* state, const char* filename) {
+
+    // Unpack members of state
+    auto& av_format_ctx = state->av_format_ctx;
+    auto& av_io_ctx = state->av_io_ctx;
+    auto& mapped_data = state->mapped_data;
+    auto& mapped_size = state->mapped_size;
+
+    int fd = open(filename, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+
+    struct stat file_stat;
+    if (fstat(fd, &file_stat) != 0 || !S_ISREG(file_stat.st_mode) || file_stat.st_size == 0) {
+        close(fd);
+        return false;
+    }
+
+    // The mapping stays valid after closing the descriptor. Truncating the file while
+    // it is mapped ends in SIGBUS, which is accepted for local clips.
+    void* data = mmap(NULL, file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (data == MAP_FAILED) {
+        return false;
+    }
+
+    mapped_data = static_cast<const uint8_t*>(data);
+    mapped_size = file_stat.st_size;
+    state->mapped_position = 0;
+    state->mapped_file = true;
+    madvise(data, mapped_size, MADV_SEQUENTIAL);
+    advise_mapped_range(state, 0);
+
+    auto buffer = static_cast<uint8_t*>(av_malloc(CUSTOM_IO_BUFFER_SIZE));
+    if (buffer) {
+        av_io_ctx = avio_alloc_context(buffer, CUSTOM_IO_BUFFER_SIZE, 0, state, read_mapped, NULL, seek_mapped);
+    }
+    if (!av_io_ctx) {
+        av_free(buffer);
+        munmap(data, mapped_size);
+        mapped_data = NULL;
+        mapped_size = 0;
+        state->mapped_file = false;
+        return false;
+    }
+
+    av_format_ctx->pb = av_io_ctx;
+    av_format_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+    return true;
+}
+
+// Demux from memory the caller loaded the file into, this reuses the callbacks of
+// the mapped input without any of the paging hints
+static bool open_memory_input(VideoReaderState* state) {
+
+    // Unpack members of state
+    auto& av_format_ctx = state->av_format_ctx;
+    auto& av_io_ctx = state->av_io_ctx;
+
+    state->mapped_data = state->memory_data;
+    state->mapped_size = state->memory_size;
+    state->mapped_position = 0;
+    state->mapped_file = false;
+
+    auto buffer = static_cast<uint8_t*>(av_malloc(CUSTOM_IO_BUFFER_SIZE));
+    if (buffer) {
+        av_io_ctx = avio_alloc_context(buffer, CUSTOM_IO_BUFFER_SIZE, 0, state, read_mapped, NULL, seek_mapped);
+    }
+    if (!av_io_ctx) {
+        av_free(buffer);
+        state->mapped_data = NULL;
+        state->mapped_size = 0;
+        return false;
+    }
+
+    av_format_ctx->pb = av_io_ctx;
+    av_format_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+    return true;
+}
+
+static int read_scheduled(void* opaque, uint8_t* buf, int buf_size) {
+    auto state = static_cast<VideoReaderState*>(opaque);
+    if (is_aborted(state)) {
+        return AVERROR_EXIT;
+    }
+    return state->io_stream->read(buf, buf_size);
+}
+
+static int64_t seek_scheduled(void* opaque, int64_t offset, int whence) {
+    return static_cast<VideoReaderState*>(opaque)->io_stream->seek(offset, whence);
+}
+
+// Read a local file through the IO scheduler of the state, which keeps a window of
+// the file read ahead of the demuxer. Returns false if the file can't be opened
+// that way, the caller falls back to the default protocol then.
+static bool open_scheduled_input(VideoReaderState* state, const char* filename) {
+
+    // Unpack members of state
+    auto& av_format_ctx = state->av_format_ctx;
+    auto& av_io_ctx = state->av_io_ctx;
+    auto& io_scheduler = state->io_scheduler;
+    auto& io_stream = state->io_stream;
+
+    io_stream = io_scheduler->openStream(filename);
+    if (!io_stream) {
+        return false;
+    }
+
+    auto buffer = static_cast<uint8_t*>(av_malloc(CUSTOM_IO_BUFFER_SIZE));
+    if (buffer) {
+        av_io_ctx = avio_alloc_context(buffer, CUSTOM_IO_BUFFER_SIZE, 0, state, read_scheduled, NULL, seek_scheduled);
+    }
+    if (!av_io_ctx) {
+        av_free(buffer);
+        io_scheduler->closeStream(io_stream);
+        io_stream = NULL;
+        return false;
+    }
+
+    av_format_ctx->pb = av_io_ctx;
+    av_format_ctx->flags |= AVFMT_FLAG_CUSTOM_IO;
+    return true;
+}
+
+// The custom AVIOContext isn't closed by libavformat
+static void close_custom_input(VideoReaderState* state) {
+    if (state->av_io_ctx) {
+        av_freep(&state->av_io_ctx->buffer);
+        avio_context_free(&state->av_io_ctx);
+    }
+    if (state->io_stream) {
+        state->io_scheduler->closeStream(state->io_stream);
+        state->io_stream = NULL;
+    }
+    if (state->mapped_data && state->mapped_file) {
+        munmap(const_cast<uint8_t*>(state->mapped_data), state->mapped_size);
+    }
+    state->mapped_data = NULL;
+    state->mapped_size = 0;
+    state->mapped_file = false;
+}
+
+static bool open_decoder(VideoReaderState* state, int lowres) {
 
     // Unpack members of state
-    auto& width = state->width;
-    auto& height = state->height;
-    auto& time_base = state->time_base;
     auto& av_format_ctx = state->av_format_ctx;
     auto& av_codec_ctx = state->av_codec_ctx;
     auto& video_stream_index = state->video_stream_index;
-    auto& av_frame = state->av_frame;
-    auto& av_packet = state->av_packet;
+
+    auto av_codec_params = av_format_ctx->streams[video_stream_index]->codecpar;
+    auto av_codec = avcodec_find_decoder(av_codec_params->codec_id);
+    if (!av_codec) {
+        printf("Couldn't find a decoder for the video stream\n");
+        return false;
+    }
+
+    // Replace the old decoder if it gets reopened with a different lowres level
+    avcodec_free_context(&av_codec_ctx);
+
+    // Set up a codec context for the decoder
+    av_codec_ctx = avcodec_alloc_context3(av_codec);
+    if (!av_codec_ctx) {
+        printf("Couldn't create AVCodecContext\n");
+        return false;
+    }
+    if (avcodec_parameters_to_context(av_codec_ctx, av_codec_params) < 0) {
+        printf("Couldn't initialize AVCodecContext\n");
+        return false;
+    }
+    av_codec_ctx->lowres = lowres;
+    av_codec_ctx->skip_frame = state->reference_only ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+    av_codec_ctx->skip_loop_filter = state->skip_loop_filter;
+    av_codec_ctx->opaque = state;
+    av_codec_ctx->get_buffer2 = get_frame_buffer;
+    if (avcodec_open2(av_codec_ctx, av_codec, NULL) < 0) {
+        printf("Couldn't open codec\n");
+        return false;
+    }
+
+    state->lowres = lowres;
+    return true;
+}
+
+bool video_reader_is_video_stream(const AVStream* stream) {
+    return stream->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && avcodec_find_decoder(stream->codecpar->codec_id);
+}
+
+// Only open the container, this is all a shared demuxer needs
+bool video_reader_open_input(VideoReaderState* state, const char* filename) {
+
+    // Unpack members of state
+    auto& av_format_ctx = state->av_format_ctx;
 
     // Open the file using libavformat
     av_format_ctx = avformat_alloc_context();
@@ -38,56 +415,111 @@ bool video_reader_open(VideoReaderState* state, const char* filename) {
         printf("Couldn't created AVFormatContext\n");
         return false;
     }
+    av_format_ctx->interrupt_callback.callback = check_abort;
+    av_format_ctx->interrupt_callback.opaque = state;
+
+    if (state->memory_data) {
+        if (!open_memory_input(state)) {
+            printf("Couldn't demux %s from memory, using the default file protocol\n", filename);
+        }
+    } else if (state->io_scheduler) {
+        if (!open_scheduled_input(state, filename)) {
+            printf("Couldn't schedule reads of %s, using the default file protocol\n", filename);
+        }
+    } else if (state->use_mmap && !open_mapped_input(state, filename)) {
+        printf("Couldn't map %s, using the default file protocol\n", filename);
+    }
 
     if (avformat_open_input(&av_format_ctx, filename, NULL, NULL) != 0) {
-        printf("Couldn't open video file\n");
+        printf(is_aborted(state) ? "Opening the video file was cancelled\n" : "Couldn't open video file\n");
         return false;
     }
 
-    // Find the first valid video stream inside the file
+    // The readahead window of a scheduled input follows the bitrate, which is
+    // estimated from the size and duration if the container doesn't store it
+    if (state->io_stream) {
+        int64_t bitrate = av_format_ctx->bit_rate;
+        if (bitrate <= 0 && av_format_ctx->duration > 0) {
+            bitrate = av_rescale(state->io_stream->getFileSize() * 8, AV_TIME_BASE, av_format_ctx->duration);
+        }
+        state->io_stream->setBitrate(bitrate);
+    }
+
+    return true;
+}
+
+bool video_reader_open(VideoReaderState* state, const char* filename) {
+
+    // Unpack members of state
+    auto& width = state->width;
+    auto& height = state->height;
+    auto& time_base = state->time_base;
+    auto& pixel_format = state->pixel_format;
+    auto& color_space = state->color_space;
+    auto& color_range = state->color_range;
+    auto& output_width = state->output_width;
+    auto& output_height = state->output_height;
+    auto& av_format_ctx = state->av_format_ctx;
+    auto& video_stream_index = state->video_stream_index;
+    auto& av_frame = state->av_frame;
+    auto& av_packet = state->av_packet;
+
+    // A shared demuxer already opened the file, otherwise the reader opens its own
+    if (state->demuxer) {
+        av_format_ctx = state->demuxer->getFormatContext();
+    } else if (!video_reader_open_input(state, filename)) {
+        return false;
+    }
+
+    // Find the requested video stream inside the file
     video_stream_index = -1;
-    AVCodecParameters* av_codec_params;
-    AVCodec* av_codec;
+    int video_stream_count = 0;
     for (int i = 0; i < av_format_ctx->nb_streams; ++i) {
-        av_codec_params = av_format_ctx->streams[i]->codecpar;
-        av_codec = avcodec_find_decoder(av_codec_params->codec_id);
-        if (!av_codec) {
+        if (!video_reader_is_video_stream(av_format_ctx->streams[i])) {
             continue;
         }
-        if (av_codec_params->codec_type == AVMEDIA_TYPE_VIDEO) {
-            video_stream_index = i;
-            width = av_codec_params->width;
-            height = av_codec_params->height;
-            time_base = av_format_ctx->streams[i]->time_base;
-            break;
+        if (video_stream_count++ != state->requested_stream) {
+            continue;
         }
+
+        auto av_codec_params = av_format_ctx->streams[i]->codecpar;
+        video_stream_index = i;
+        width = av_codec_params->width;
+        height = av_codec_params->height;
+        time_base = av_format_ctx->streams[i]->time_base;
+        pixel_format = static_cast<AVPixelFormat>(av_codec_params->format);
+        color_space = av_codec_params->color_space;
+        color_range = av_codec_params->color_range;
+        break;
     }
     if (video_stream_index == -1) {
         printf("Couldn't find valid video stream inside file\n");
         return false;
     }
-
-    // Set up a codec context for the decoder
-    av_codec_ctx = avcodec_alloc_context3(av_codec);
-    if (!av_codec_ctx) {
-        printf("Couldn't create AVCodecContext\n");
-        return false;
+    if (state->demuxer) {
+        state->demuxer->addConsumer(video_stream_index);
     }
-    if (avcodec_parameters_to_context(av_codec_ctx, av_codec_params) < 0) {
-        printf("Couldn't initialize AVCodecContext\n");
+
+    output_width = width;
+    output_height = height;
+
+    // Setting up the decoder is the other slow part, it is skipped if the open was cancelled while probing
+    if (is_aborted(state)) {
+        printf("Opening the video file was cancelled\n");
         return false;
     }
-    if (avcodec_open2(av_codec_ctx, av_codec, NULL) < 0) {
-        printf("Couldn't open codec\n");
+
+    // Set up a codec context for the decoder
+    if (!open_decoder(state, 0)) {
         return false;
     }
 
-    av_frame = av_frame_alloc();
+    av_frame = state->packet_pool ? state->packet_pool->acquireFrame() : av_frame_alloc();
     if (!av_frame) {
         printf("Couldn't allocate AVFrame\n");
         return false;
     }
-    av_packet = av_packet_alloc();
+    av_packet = state->packet_pool ? state->packet_pool->acquirePacket() : av_packet_alloc();
     if (!av_packet) {
         printf("Couldn't allocate AVPacket\n");
         return false;
@@ -96,24 +528,109 @@ bool video_reader_open(VideoReaderState* state, const char* filename) {
     return true;
 }
 
+static int64_t frame_timestamp(const AVFrame* frame) {
+    // Some containers don't set pts on every frame, fall back to the decoder's guess
+    if (frame->pts != AV_NOPTS_VALUE) {
+        return frame->pts;
+    }
+    return frame->best_effort_timestamp;
+}
+
+bool video_reader_is_mapped(const VideoReaderState* state) {
+    return state->mapped_data != NULL && state->mapped_file;
+}
+
+bool video_reader_is_in_memory(const VideoReaderState* state) {
+    return state->mapped_data != NULL && !state->mapped_file;
+}
+
+bool video_reader_demux_to_end(VideoReaderState* state, uint64_t* packet_count, uint64_t* byte_count) {
+
+    // Unpack members of state
+    auto& av_packet = state->av_packet;
+
+    int response;
+    while ((response = read_packet(state, av_packet)) >= 0) {
+        *packet_count += 1;
+        *byte_count += av_packet->size;
+        av_packet_unref(av_packet);
+    }
+
+    if (response != AVERROR_EOF) {
+        printf("Failed to demux packet: %s\n", av_make_error(response));
+        return false;
+    }
+
+    state->end_of_stream = true;
+    return true;
+}
+
 bool video_reader_read_frame(VideoReaderState* state, uint8_t* frame_buffer, int64_t* pts) {
+    if (!video_reader_decode_frame(state, pts)) {
+        return false;
+    }
+
+    return video_reader_convert_frame(state, frame_buffer);
+}
+
+bool video_reader_decode_frame(VideoReaderState* state, int64_t* pts) {
 
     // Unpack members of state
-    auto& width = state->width;
-    auto& height = state->height;
-    auto& av_format_ctx = state->av_format_ctx;
     auto& av_codec_ctx = state->av_codec_ctx;
     auto& video_stream_index = state->video_stream_index;
     auto& av_frame = state->av_frame;
     auto& av_packet = state->av_packet;
-    auto& sws_scaler_ctx = state->sws_scaler_ctx;
+    auto& lowres = state->lowres;
+    auto& requested_lowres = state->requested_lowres;
+    auto& decoder_draining = state->decoder_draining;
+    auto& packet_pending = state->packet_pending;
 
     // Decode one frame
     int response;
-    while (av_read_frame(av_format_ctx, av_packet) >= 0) {
-        if (av_packet->stream_index != video_stream_index) {
-            av_packet_unref(av_packet);
-            continue;
+    while (true) {
+        // A draining decoder gives back the frames it still holds, before the end of
+        // the stream or before the keyframe that waits for the new lowres level
+        if (decoder_draining) {
+            response = avcodec_receive_frame(av_codec_ctx, av_frame);
+            if (response >= 0) {
+                *pts = av_frame->pts;
+                return true;
+            } else if (response != AVERROR_EOF) {
+                printf("Failed to decode packet: %s\n", av_make_error(response));
+                return false;
+            }
+
+            // A decoder drained at the end of the stream has nothing left
+            decoder_draining = false;
+            if (!packet_pending) {
+                break;
+            }
+            packet_pending = false;
+            if (!open_decoder(state, requested_lowres)) {
+                av_packet_unref(av_packet);
+                return false;
+            }
+        } else {
+            // Nothing left to demux, the frames the decoder still holds are returned first
+            if (read_packet(state, av_packet) < 0) {
+                avcodec_send_packet(av_codec_ctx, NULL);
+                decoder_draining = true;
+                continue;
+            }
+            if (av_packet->stream_index != video_stream_index) {
+                av_packet_unref(av_packet);
+                continue;
+            }
+
+            // The decoder can only change its lowres level when it is reopened,
+            // doing that on a keyframe switches the LOD without a visible gap.
+            // The packet is held until the old decoder is drained.
+            if (requested_lowres != lowres && (av_packet->flags & AV_PKT_FLAG_KEY)) {
+                avcodec_send_packet(av_codec_ctx, NULL);
+                decoder_draining = true;
+                packet_pending = true;
+                continue;
+            }
         }
 
         response = avcodec_send_packet(av_codec_ctx, av_packet);
@@ -132,31 +649,84 @@ bool video_reader_read_frame(VideoReaderState* state, uint8_t* frame_buffer, int
         }
 
         av_packet_unref(av_packet);
-        break;
+        *pts = av_frame->pts;
+        return true;
     }
 
+    // The decoder is empty, the last frame is kept
+    state->end_of_stream = true;
     *pts = av_frame->pts;
-    
-    // Set up sws scaler
-    //if (!sws_scaler_ctx) {
-        auto source_pix_fmt = correct_for_deprecated_pixel_format(av_codec_ctx->pix_fmt);
-        sws_scaler_ctx = sws_getContext(width, height, source_pix_fmt,
-                                        width, height, AV_PIX_FMT_RGB0,
-                                        SWS_BILINEAR, NULL, NULL, NULL);
-    //}
+
+    return true;
+}
+
+bool video_reader_convert_frame(VideoReaderState* state, uint8_t* frame_buffer) {
+    return video_reader_convert_frame_from(state, state->av_frame, frame_buffer);
+}
+
+// Convert a frame that was taken out of the reader earlier
+bool video_reader_convert_frame_from(VideoReaderState* state, const AVFrame* av_frame, uint8_t* frame_buffer) {
+
+    // Unpack members of state
+    auto& output_width = state->output_width;
+    auto& output_height = state->output_height;
+    auto& sws_scaler_ctx = state->sws_scaler_ctx;
+
+    // Set up sws scaler, the cached context is only rebuilt if the source or the
+    // output size changes. The frame size is used as source since a lowres decoder
+    // outputs frames smaller than the stream.
+    auto source_pix_fmt = correct_for_deprecated_pixel_format(static_cast<AVPixelFormat>(av_frame->format));
+    sws_scaler_ctx = sws_getCachedContext(sws_scaler_ctx,
+                                          av_frame->width, av_frame->height, source_pix_fmt,
+                                          output_width, output_height, AV_PIX_FMT_RGB0,
+                                          state->scale_flags, NULL, NULL, NULL);
     if (!sws_scaler_ctx) {
         printf("Couldn't initialize sw scaler\n");
         return false;
     }
 
+    // Convert with the matrix and range the native path uses in the shader. The JPEG
+    // formats are full range, that information is lost with the corrected format.
+    auto descriptor = av_pix_fmt_desc_get(source_pix_fmt);
+    if (descriptor && !(descriptor->flags & AV_PIX_FMT_FLAG_RGB)) {
+        bool full_range = state->color_range == AVCOL_RANGE_JPEG || source_pix_fmt != av_frame->format;
+        const int* coefficients = sws_getCoefficients(sws_colorspace_of(state));
+        sws_setColorspaceDetails(sws_scaler_ctx, coefficients, full_range ? 1 : 0,
+                                 sws_getCoefficients(SWS_CS_DEFAULT), 1, 0, 1 << 16, 1 << 16);
+    }
+
     uint8_t* dest[4] = { frame_buffer, NULL, NULL, NULL };
-    int dest_linesize[4] = { width * 4, 0, 0, 0 };
+    int dest_linesize[4] = { output_width * 4, 0, 0, 0 };
     sws_scale(sws_scaler_ctx, av_frame->data, av_frame->linesize, 0, av_frame->height, dest, dest_linesize);
 
     return true;
 }
 
+bool video_reader_is_native_format(int format) {
+    return format == AV_PIX_FMT_YUV420P || format == AV_PIX_FMT_YUVJ420P || format == AV_PIX_FMT_NV12;
+}
+
+bool video_reader_ref_frame(VideoReaderState* state, AVFrame* frame) {
+
+    // Unpack members of state
+    auto& av_frame = state->av_frame;
+
+    // The reference keeps the buffers from being reused by the decoder
+    av_frame_unref(frame);
+    int response = av_frame_ref(frame, av_frame);
+    if (response < 0) {
+        printf("Couldn't reference frame: %s\n", av_make_error(response));
+        return false;
+    }
+
+    return true;
+}
+
 bool video_reader_seek_frame(VideoReaderState* state, int64_t ts) {
+    if (state->demuxer) {
+        printf("Readers of a shared demuxer can't seek\n");
+        return false;
+    }
     
     // Unpack members of state
     auto& av_format_ctx = state->av_format_ctx;
@@ -167,11 +737,23 @@ bool video_reader_seek_frame(VideoReaderState* state, int64_t ts) {
     
     av_seek_frame(av_format_ctx, video_stream_index, ts, AVSEEK_FLAG_BACKWARD);
 
+    // A decoder that was drained at the end of the stream, or whose drain was cut
+    // short by the seek, only accepts packets again after a flush
+    if (state->decoder_draining || state->end_of_stream) {
+        if (state->packet_pending) {
+            av_packet_unref(av_packet);
+        }
+        avcodec_flush_buffers(av_codec_ctx);
+        state->decoder_draining = false;
+        state->packet_pending = false;
+    }
+    state->end_of_stream = false;
+
     // av_seek_frame takes effect after one frame, so I'm decoding one here
     // so that the next call to video_reader_read_frame() will give the correct
     // frame
     int response;
-    while (av_read_frame(av_format_ctx, av_packet) >= 0) {
+    while (read_packet(state, av_packet) >= 0) {
         if (av_packet->stream_index != video_stream_index) {
             av_packet_unref(av_packet);
             continue;
@@ -199,11 +781,194 @@ bool video_reader_seek_frame(VideoReaderState* state, int64_t ts) {
     return true;
 }
 
+void video_reader_set_output_size(VideoReaderState* state, int display_width, int display_height) {
+
+    // Unpack members of state
+    auto& width = state->width;
+    auto& height = state->height;
+    auto& output_width = state->output_width;
+    auto& output_height = state->output_height;
+    auto& av_codec_ctx = state->av_codec_ctx;
+    auto& requested_lowres = state->requested_lowres;
+
+    // Pick the smallest level that still covers the display size
+    int level = 0;
+    for (int i = 0; i < (int)(sizeof(lod_levels) / sizeof(lod_levels[0])); ++i) {
+        if (width * lod_levels[i][0] / lod_levels[i][1] < display_width ||
+            height * lod_levels[i][0] / lod_levels[i][1] < display_height) {
+            break;
+        }
+        level = i;
+    }
+    level = std::min(level + state->lod_bias, (int)(sizeof(lod_levels) / sizeof(lod_levels[0])) - 1);
+
+    // Keep the size even, chroma subsampled formats can't handle odd sizes well
+    output_width = std::max(2, (width * lod_levels[level][0] / lod_levels[level][1]) & ~1);
+    output_height = std::max(2, (height * lod_levels[level][0] / lod_levels[level][1]) & ~1);
+
+    // Let the decoder skip resolution as well if it supports it (mostly intra codecs
+    // like mjpeg), the decoded frame still has to be at least the output size
+    int max_lowres = av_codec_ctx->codec ? av_codec_ctx->codec->max_lowres : 0;
+    requested_lowres = 0;
+    while (requested_lowres < max_lowres &&
+           (width >> (requested_lowres + 1)) >= output_width &&
+           (height >> (requested_lowres + 1)) >= output_height) {
+        ++requested_lowres;
+    }
+}
+
+void video_reader_set_reference_only(VideoReaderState* state, bool reference_only) {
+    // Non-reference frames are only demuxed and dropped by the decoder. The
+    // reference frames keep getting decoded, so switching back is instant and
+    // the stream stays in sync without seeking.
+    state->reference_only = reference_only;
+    state->av_codec_ctx->skip_frame = reference_only ? AVDISCARD_NONREF : AVDISCARD_DEFAULT;
+}
+
+void video_reader_set_quality(VideoReaderState* state, int lod_bias, int scale_flags, AVDiscard skip_loop_filter) {
+    // The LOD bias and the scale flags are picked up by the next conversion,
+    // the loop filter setting is read by the decoder for every frame
+    state->lod_bias = lod_bias;
+    state->scale_flags = scale_flags;
+    state->skip_loop_filter = skip_loop_filter;
+    state->av_codec_ctx->skip_loop_filter = skip_loop_filter;
+}
+
+bool video_reader_build_keyframe_index(VideoReaderState* state) {
+    if (state->demuxer) {
+        printf("Readers of a shared demuxer can't seek\n");
+        return false;
+    }
+
+    // Unpack members of state
+    auto& av_format_ctx = state->av_format_ctx;
+    auto& av_codec_ctx = state->av_codec_ctx;
+    auto& video_stream_index = state->video_stream_index;
+    auto& av_packet = state->av_packet;
+    auto& keyframe_index = state->keyframe_index;
+
+    // Keyframes are flagged by the demuxer, so nothing has to be decoded here
+    keyframe_index.clear();
+    while (read_packet(state, av_packet) >= 0) {
+        if (av_packet->stream_index == video_stream_index && (av_packet->flags & AV_PKT_FLAG_KEY)) {
+            int64_t ts = av_packet->pts != AV_NOPTS_VALUE ? av_packet->pts : av_packet->dts;
+            if (ts != AV_NOPTS_VALUE) {
+                keyframe_index.push_back(ts);
+            }
+        }
+        av_packet_unref(av_packet);
+    }
+
+    if (keyframe_index.empty()) {
+        printf("Couldn't find any keyframes in the video stream\n");
+        return false;
+    }
+    std::sort(keyframe_index.begin(), keyframe_index.end());
+
+    // Rewind so the next read starts at the beginning of the stream again
+    if (av_seek_frame(av_format_ctx, video_stream_index, keyframe_index.front(), AVSEEK_FLAG_BACKWARD) < 0) {
+        printf("Couldn't rewind after building the keyframe index\n");
+        return false;
+    }
+    avcodec_flush_buffers(av_codec_ctx);
+
+    return true;
+}
+
+bool video_reader_decode_gop(VideoReaderState* state, int64_t start_pts, int64_t end_pts,
+                             const std::function<bool(int64_t pts)>& on_frame) {
+    if (state->demuxer) {
+        printf("Readers of a shared demuxer can't seek\n");
+        return false;
+    }
+
+    // Unpack members of state
+    auto& av_format_ctx = state->av_format_ctx;
+    auto& av_codec_ctx = state->av_codec_ctx;
+    auto& video_stream_index = state->video_stream_index;
+    auto& av_frame = state->av_frame;
+    auto& av_packet = state->av_packet;
+
+    if (av_seek_frame(av_format_ctx, video_stream_index, start_pts, AVSEEK_FLAG_BACKWARD) < 0) {
+        printf("Couldn't seek to the start of the GOP\n");
+        return false;
+    }
+    avcodec_flush_buffers(av_codec_ctx);
+
+    // Frames are returned in presentation order. Everything before start_pts is a
+    // leading picture of the previous GOP and is dropped, the first frame at or after
+    // end_pts belongs to the next GOP and ends the decoding. Decoding through the next
+    // keyframe keeps the leading pictures of open GOPs intact.
+    bool draining = false;
+    int response;
+    while (true) {
+        if (!draining) {
+            if (read_packet(state, av_packet) < 0) {
+                // End of file, flush the remaining frames out of the decoder
+                draining = true;
+                avcodec_send_packet(av_codec_ctx, NULL);
+            } else if (av_packet->stream_index != video_stream_index) {
+                av_packet_unref(av_packet);
+                continue;
+            } else {
+                response = avcodec_send_packet(av_codec_ctx, av_packet);
+                av_packet_unref(av_packet);
+                if (response < 0) {
+                    printf("Failed to decode packet: %s\n", av_make_error(response));
+                    return false;
+                }
+            }
+        }
+
+        while (true) {
+            response = avcodec_receive_frame(av_codec_ctx, av_frame);
+            if (response == AVERROR(EAGAIN)) {
+                break;
+            } else if (response == AVERROR_EOF) {
+                avcodec_flush_buffers(av_codec_ctx);
+                return true;
+            } else if (response < 0) {
+                printf("Failed to decode packet: %s\n", av_make_error(response));
+                return false;
+            }
+
+            int64_t pts = frame_timestamp(av_frame);
+            if (pts >= end_pts) {
+                av_frame_unref(av_frame);
+                avcodec_flush_buffers(av_codec_ctx);
+                return true;
+            }
+
+            if (pts >= start_pts && !on_frame(pts)) {
+                av_frame_unref(av_frame);
+                avcodec_flush_buffers(av_codec_ctx);
+                return false;
+            }
+            av_frame_unref(av_frame);
+        }
+    }
+}
+
 void video_reader_close(VideoReaderState* state) {
     sws_freeContext(state->sws_scaler_ctx);
+
+    // The format context of a shared demuxer stays open for its other readers
+    if (state->demuxer) {
+        if (state->av_format_ctx && state->video_stream_index >= 0) {
+            state->demuxer->removeConsumer(state->video_stream_index);
+        }
+        state->av_format_ctx = NULL;
+    }
     avformat_close_input(&state->av_format_ctx);
     avformat_free_context(state->av_format_ctx);
-    av_frame_free(&state->av_frame);
-    av_packet_free(&state->av_packet);
+    close_custom_input(state);
+    if (state->packet_pool) {
+        state->packet_pool->release(state->av_frame);
+        state->packet_pool->release(state->av_packet);
+    } else {
+        av_frame_free(&state->av_frame);
+        av_packet_free(&state->av_packet);
+    }
     avcodec_free_context(&state->av_codec_ctx);
+    av_buffer_pool_uninit(&state->frame_pool);
 }
@@ -0,0 +1,495 @@
+#include "video_tile.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+namespace{
+    struct QualitySettings{
+        int lodBias;
+        int scaleFlags;
+        AVDiscard skipLoopFilter;
+        int frameStep;
+        //the decoder skips the non-reference frames, so the dropped frames save decoding as well
+        bool referenceOnly;
+        const char* description;
+    };
+
+    //every level adds one cheaper mode on top of the previous one
+    const QualitySettings qualityLevels[sakurajin::VideoTile::maxQualityLevel + 1] = {
+        {0, SWS_BILINEAR,      AVDISCARD_DEFAULT, 1, false, "full quality"},
+        {0, SWS_FAST_BILINEAR, AVDISCARD_DEFAULT, 1, false, "fast scaling"},
+        {1, SWS_FAST_BILINEAR, AVDISCARD_NONREF,  1, false, "lower LOD, no loop filter on non-reference frames"},
+        {1, SWS_FAST_BILINEAR, AVDISCARD_ALL,     1, false, "lower LOD, no loop filter"},
+        {2, SWS_POINT,         AVDISCARD_ALL,     2, true,  "lowest LOD, half frame rate, non-reference frames not decoded"},
+    };
+
+    //the GOP decoder of reverse tiles decodes at the native size without the realtime
+    //reader, so dropping frames is the only cheaper mode it has
+    constexpr int maxReverseQualityLevel = 1;
+    const QualitySettings reverseQualityLevels[maxReverseQualityLevel + 1] = {
+        {0, SWS_BILINEAR, AVDISCARD_DEFAULT, 1, false, "full quality"},
+        {0, SWS_BILINEAR, AVDISCARD_DEFAULT, 2, true,  "half frame rate, non-reference frames not decoded"},
+    };
+
+    //the memory the planes of a frame keep alive, the chroma planes of the YUV formats have half the rows
+    size_t getFrameBytes(const sakurajin::FrameView& frame){
+        size_t bytes = static_cast<size_t>(frame.linesizes[0]) * frame.height;
+        for(int plane = 1; plane < 3; plane++){
+            bytes += static_cast<size_t>(frame.linesizes[plane]) * ((frame.height + 1) / 2);
+        }
+        return bytes;
+    }
+}
+
+sakurajin::VideoTile::VideoTile ( const std::string& _filename, const MediaResources& _resources, bool reverse ) : filename{_filename}, resources{_resources} {
+    //short clips are demuxed from memory, their loading started when they were queued
+    preloadedClip = resources.loadClip(filename);
+    resources.configureReader(&reader, preloadedClip.get());
+    if(!video_reader_open(&reader, filename.c_str())){
+        video_reader_close(&reader);
+        throw std::runtime_error("could not open video file " + filename);
+    }
+
+    //reverse playback is not realtime bound, so the GOPs are decoded in parallel
+    if(reverse){
+        try{
+            gopDecoder = std::make_unique<GopDecoder>(filename, resources, GopDecoder::Direction::reverse);
+        }catch(...){
+            video_reader_close(&reader);
+            std::throw_with_nested(std::runtime_error("could not start reverse playback of " + filename));
+        }
+    }
+
+    //the GOP decoder hands out its own frames, only the realtime reader needs frame references
+    if(!gopDecoder){
+        acquireFrames();
+    }
+}
+
+sakurajin::VideoTile::VideoTile ( std::shared_ptr<StreamDemuxer> _demuxer, int _stream, const MediaResources& _resources ) : filename{_demuxer->getFilename()}, resources{_resources}, demuxer{std::move(_demuxer)}, stream{_stream} {
+    //the demuxer reads the preloaded clip, the reader only decodes its stream
+    preloadedClip = demuxer->getPreloadedClip();
+    resources.configureReader(&reader, nullptr);
+    reader.demuxer = demuxer.get();
+    reader.requested_stream = stream;
+    if(!video_reader_open(&reader, filename.c_str())){
+        video_reader_close(&reader);
+        throw std::runtime_error("could not open video stream " + std::to_string(stream) + " of " + filename);
+    }
+
+    acquireFrames();
+}
+
+void sakurajin::VideoTile::acquireFrames() {
+    dueFrame = resources.packets.acquireFrame();
+    if(!dueFrame){
+        video_reader_close(&reader);
+        throw std::runtime_error("could not allocate frame reference");
+    }
+
+    //only YUV420P and NV12 frames are uploaded without conversion
+    if(!video_reader_is_native_format(reader.pixel_format)){
+        return;
+    }
+
+    nativeFrame = resources.packets.acquireFrame();
+    if(!nativeFrame){
+        resources.packets.release(dueFrame);
+        video_reader_close(&reader);
+        throw std::runtime_error("could not allocate frame reference");
+    }
+}
+
+sakurajin::VideoTile::~VideoTile() {
+    gopDecoder.reset();
+
+    //the references have to be released before the buffer pool of the reader is closed
+    pruneHistory(std::numeric_limits<double>::infinity());
+    resources.packets.release(nativeFrame);
+    resources.packets.release(dueFrame);
+    video_reader_close(&reader);
+}
+
+void sakurajin::VideoTile::setDisplaySize ( int width, int height ) {
+    //the parallel GOP decoder always works at the native size
+    if(gopDecoder){
+        return;
+    }
+
+    video_reader_set_output_size(&reader, width, height);
+}
+
+void sakurajin::VideoTile::setVisible ( bool _visible ) {
+    if(visible == _visible){
+        return;
+    }
+    visible = _visible;
+
+    if(!gopDecoder){
+        video_reader_set_reference_only(&reader, !visible || qualityLevels[qualityLevel].referenceOnly);
+    }
+}
+
+bool sakurajin::VideoTile::isVisible() const {
+    return visible;
+}
+
+void sakurajin::VideoTile::setPlaybackState ( PlaybackState state ) {
+    playbackState = state;
+}
+
+sakurajin::VideoTile::PlaybackState sakurajin::VideoTile::getPlaybackState() const {
+    return playbackState;
+}
+
+void sakurajin::VideoTile::setPriority ( int _priority ) {
+    priority = _priority;
+}
+
+int sakurajin::VideoTile::getPriority() const {
+    return priority;
+}
+
+void sakurajin::VideoTile::setQualityLevel ( int level ) {
+    qualityLevel = std::clamp(level, 0, getMaxQualityLevel());
+
+    if(gopDecoder){
+        frameStep = reverseQualityLevels[qualityLevel].frameStep;
+        gopDecoder->setReferenceOnly(reverseQualityLevels[qualityLevel].referenceOnly);
+        return;
+    }
+
+    const auto& settings = qualityLevels[qualityLevel];
+    frameStep = settings.frameStep;
+    video_reader_set_quality(&reader, settings.lodBias, settings.scaleFlags, settings.skipLoopFilter);
+    video_reader_set_reference_only(&reader, !visible || settings.referenceOnly);
+}
+
+int sakurajin::VideoTile::getQualityLevel() const {
+    return qualityLevel;
+}
+
+int sakurajin::VideoTile::getMaxQualityLevel() const {
+    return gopDecoder ? maxReverseQualityLevel : maxQualityLevel;
+}
+
+const char* sakurajin::VideoTile::getQualityDescription() const {
+    return gopDecoder ? reverseQualityLevels[qualityLevel].description : qualityLevels[qualityLevel].description;
+}
+
+double sakurajin::VideoTile::getFrameTime ( int64_t framePts ) const {
+    //reverse playback counts down from the first frame
+    auto distance = gopDecoder ? firstPts - framePts : framePts - firstPts;
+    return distance * av_q2d(reader.time_base);
+}
+
+bool sakurajin::VideoTile::decodeNextFrame() {
+    if(gopDecoder){
+        try{
+            return gopDecoder->nextFrame(pendingGopFrame, pendingPts);
+        }catch(...){
+            std::throw_with_nested(std::runtime_error("could not decode reverse frame of " + filename));
+        }
+    }
+
+    if(!video_reader_decode_frame(&reader, &pendingPts)){
+        throw std::runtime_error("could not load video frame of " + filename);
+    }
+    return !reader.end_of_stream;
+}
+
+bool sakurajin::VideoTile::takePendingFrame() {
+    pts = pendingPts;
+    hasPendingFrame = false;
+
+    //hidden tiles only keep the time, converting is skipped
+    if(!visible){
+        return false;
+    }
+
+    //the quality governor can drop frames on the way to the screen
+    if(presentedFrames++ % frameStep != 0){
+        return false;
+    }
+
+    //moving the reference replaces an overdue frame without touching its data
+    if(gopDecoder){
+        dueGopFrame = std::move(pendingGopFrame);
+    }else{
+        av_frame_unref(dueFrame);
+        av_frame_move_ref(dueFrame, reader.av_frame);
+    }
+    hasDueFrame = true;
+    return true;
+}
+
+bool sakurajin::VideoTile::presentDueFrame() {
+    if(!std::exchange(hasDueFrame, false)){
+        return false;
+    }
+
+    if(gopDecoder){
+        //the GOP frame is shared, it stays alive while it is shown
+        setFrame(std::move(dueGopFrame), gopDecoder->getWidth(), gopDecoder->getHeight());
+        addToHistory();
+        return true;
+    }
+
+    //the decoder can still switch formats mid-stream, those frames are converted.
+    //Decoders without lowres support output the full size, those frames are scaled
+    //down to the LOD size by the conversion instead of being uploaded at full size.
+    if(nativeFrame && video_reader_is_native_format(dueFrame->format) && isLodSize(dueFrame)){
+        presentNativeFrame();
+        addToHistory();
+        return true;
+    }
+
+    //only the LOD size is converted, so only that much has to be uploaded.
+    //The buffer of the last frame goes back to the pool and is picked up again next time.
+    auto data = resources.frameMemory.acquire(static_cast<size_t>(reader.output_width) * reader.output_height * 4);
+    if(!video_reader_convert_frame_from(&reader, dueFrame, data.get())){
+        throw std::runtime_error("could not convert video frame of " + filename);
+    }
+    av_frame_unref(dueFrame);
+    setFrame(std::move(data), reader.output_width, reader.output_height);
+    addToHistory();
+    return true;
+}
+
+void sakurajin::VideoTile::addToHistory() {
+    if(historyLength <= 0.0){
+        return;
+    }
+
+    HistoryFrame entry{getFrameTime(pts), currentFrame, frameData, nullptr, getFrameBytes(currentFrame)};
+
+    //a native frame gets its own reference, the planes of a reference point to the same buffers
+    if(!frameData && nativeFrame){
+        entry.native = resources.packets.acquireFrame();
+        if(!entry.native || av_frame_ref(entry.native, nativeFrame) < 0){
+            resources.packets.release(entry.native);
+            return;
+        }
+    }
+
+    //the ring only grows until it holds the history length, then the pruned slots are reused
+    if(historyCount == history.size()){
+        std::vector<HistoryFrame> grown(std::max<size_t>(history.size() * 2, 16));
+        for(size_t i = 0; i < historyCount; i++){
+            grown[i] = std::move(historyAt(i));
+        }
+        history = std::move(grown);
+        historyFirst = 0;
+    }
+
+    historyBytes += entry.bytes;
+    historyAt(historyCount++) = std::move(entry);
+    pruneHistory(historyAt(historyCount - 1).time - historyLength);
+
+    //above the byte limit the history gets shorter than requested,
+    //mirrors delayed further than it reaches show the oldest kept frame
+    while(historyCount > 1 && historyBytes > historyByteLimit){
+        dropOldestHistoryFrame();
+    }
+}
+
+void sakurajin::VideoTile::pruneHistory ( double keepAfter ) {
+    //the newest frame before the limit stays, it is the one shown at the limit
+    while(historyCount > 0 && (historyCount > 1 ? historyAt(1).time <= keepAfter : historyAt(0).time < keepAfter)){
+        dropOldestHistoryFrame();
+    }
+}
+
+void sakurajin::VideoTile::dropOldestHistoryFrame() {
+    auto& oldest = historyAt(0);
+    resources.packets.release(oldest.native);
+    oldest.data.reset();
+    historyBytes -= oldest.bytes;
+    historyFirst = (historyFirst + 1) % history.size();
+    historyCount--;
+}
+
+sakurajin::VideoTile::HistoryFrame& sakurajin::VideoTile::historyAt ( size_t index ) {
+    return history[(historyFirst + index) % history.size()];
+}
+
+const sakurajin::VideoTile::HistoryFrame& sakurajin::VideoTile::historyAt ( size_t index ) const {
+    return history[(historyFirst + index) % history.size()];
+}
+
+bool sakurajin::VideoTile::prepare() {
+    if(firstPts != AV_NOPTS_VALUE || finished){
+        return preparedFrame;
+    }
+
+    //the clock only starts with the first update, so the frame waits at the start of the clip
+    if(!decodeNextFrame()){
+        finished = true;
+        return false;
+    }
+    firstPts = pendingPts;
+    hasPendingFrame = true;
+
+    preparedFrame = takePendingFrame() && presentDueFrame();
+    return preparedFrame;
+}
+
+bool sakurajin::VideoTile::update ( double deltaSeconds ) {
+    //a frame shown by prepare() still has to be uploaded
+    bool newFrame = std::exchange(preparedFrame, false);
+
+    if(playbackState == PlaybackState::paused || finished){
+        return newFrame;
+    }
+
+    //the first frame is shown right away and starts the clock
+    if(firstPts == AV_NOPTS_VALUE){
+        if(!decodeNextFrame()){
+            finished = true;
+            return false;
+        }
+        firstPts = pendingPts;
+        hasPendingFrame = true;
+    }else{
+        playhead += deltaSeconds;
+    }
+
+    while(true){
+        if(!hasPendingFrame){
+            if(!decodeNextFrame()){
+                finished = true;
+                break;
+            }
+            hasPendingFrame = true;
+        }
+
+        if(getFrameTime(pendingPts) > playhead){
+            break;
+        }
+
+        //a tile that fell behind only shows the newest due frame
+        takePendingFrame();
+    }
+
+    if(presentDueFrame()){
+        newFrame = true;
+    }
+
+    return newFrame;
+}
+
+bool sakurajin::VideoTile::isLodSize ( const AVFrame* frame ) const {
+    //the output size is rounded down to even values, the frame itself can be odd
+    return (frame->width & ~1) == reader.output_width && (frame->height & ~1) == reader.output_height;
+}
+
+bool sakurajin::VideoTile::presentNativeFrame() {
+    //the reference keeps the pooled decoder buffer alive until the next frame is shown
+    av_frame_unref(nativeFrame);
+    av_frame_move_ref(nativeFrame, dueFrame);
+
+    //the frame already has the LOD size, there is no scaling on this path
+    FrameView frame;
+    frame.format = nativeFrame->format == AV_PIX_FMT_NV12 ? PixelFormat::nv12 : PixelFormat::yuv420p;
+    frame.width = nativeFrame->width;
+    frame.height = nativeFrame->height;
+
+    const int planeCount = frame.format == PixelFormat::nv12 ? 2 : 3;
+    for(int i = 0; i < planeCount; i++){
+        frame.planes[i] = nativeFrame->data[i];
+        frame.linesizes[i] = nativeFrame->linesize[i];
+    }
+
+    //a converted frame from before the format change isn't needed anymore
+    frameData.reset();
+    currentFrame = frame;
+    return true;
+}
+
+void sakurajin::VideoTile::setFrame ( FrameMemory data, int width, int height ) {
+    frameData = std::move(data);
+    currentFrame = FrameView{};
+    currentFrame.planes[0] = frameData.get();
+    currentFrame.linesizes[0] = width * 4;
+    currentFrame.width = width;
+    currentFrame.height = height;
+}
+
+const sakurajin::FrameView& sakurajin::VideoTile::getFrame() const {
+    return currentFrame;
+}
+
+void sakurajin::VideoTile::setHistoryLength ( double seconds, size_t maxBytes ) {
+    historyLength = std::max(seconds, 0.0);
+    historyByteLimit = maxBytes;
+    if(historyLength == 0.0){
+        pruneHistory(std::numeric_limits<double>::infinity());
+    }
+}
+
+const sakurajin::FrameView& sakurajin::VideoTile::getDelayedFrame ( double delay, double& frameTime ) const {
+    if(delay <= 0.0 || historyCount == 0){
+        frameTime = firstPts == AV_NOPTS_VALUE ? 0.0 : getFrameTime(pts);
+        return currentFrame;
+    }
+
+    //the history is sorted by time, the newest frame that was already shown at that time is picked
+    const double time = playhead - delay;
+    for(size_t i = historyCount; i > 0; i--){
+        const auto& entry = historyAt(i - 1);
+        if(entry.time <= time){
+            frameTime = entry.time;
+            return entry.frame;
+        }
+    }
+    frameTime = historyAt(0).time;
+    return historyAt(0).frame;
+}
+
+int sakurajin::VideoTile::getFrameWidth() const {
+    return currentFrame.width;
+}
+
+int sakurajin::VideoTile::getFrameHeight() const {
+    return currentFrame.height;
+}
+
+float sakurajin::VideoTile::getAspectRatio() const {
+    return static_cast<float>(reader.width) / static_cast<float>(reader.height);
+}
+
+sakurajin::ShaderVariantKey sakurajin::VideoTile::getShaderVariant() const {
+    //converted frames are RGBA, only the alpha handling depends on the stream then
+    auto key = ShaderVariantKey::fromStream(reader.pixel_format, reader.color_space, reader.color_range, reader.height);
+    key.pixelFormat = currentFrame.format;
+    return key;
+}
+
+int64_t sakurajin::VideoTile::getPts() const {
+    return pts;
+}
+
+double sakurajin::VideoTile::getPlayhead() const {
+    return playhead;
+}
+
+bool sakurajin::VideoTile::isFinished() const {
+    return finished;
+}
+
+bool sakurajin::VideoTile::isReverse() const {
+    return gopDecoder != nullptr;
+}
+
+const std::string& sakurajin::VideoTile::getFilename() const {
+    return filename;
+}
+
+const sakurajin::PreloadedClip* sakurajin::VideoTile::getPreloadedClip() const {
+    return preloadedClip.get();
+}
+
+int sakurajin::VideoTile::getStream() const {
+    return stream;
+}
@@ -0,0 +1,59 @@
+#include "worker_pool.hpp"
+
+sakurajin::WorkerPool::WorkerPool ( unsigned int threadCount ) {
+    if(threadCount == 0){
+        threadCount = std::thread::hardware_concurrency();
+    }
+    if(threadCount == 0){
+        threadCount = 1;
+    }
+
+    workers.reserve(threadCount);
+    for(unsigned int i = 0; i < threadCount; i++){
+        workers.emplace_back(&WorkerPool::workerLoop, this);
+    }
+}
+
+sakurajin::WorkerPool::~WorkerPool() {
+    {
+        std::scoped_lock lock{jobMutex};
+        stopping = true;
+    }
+    jobAvailable.notify_all();
+
+    //the remaining jobs are still run so no future is left without a value
+    for(auto& worker : workers){
+        worker.join();
+    }
+}
+
+unsigned int sakurajin::WorkerPool::size() const {
+    return workers.size();
+}
+
+void sakurajin::WorkerPool::enqueue ( std::function<void()> job ) {
+    {
+        std::scoped_lock lock{jobMutex};
+        jobs.emplace_back(std::move(job));
+    }
+    jobAvailable.notify_one();
+}
+
+void sakurajin::WorkerPool::workerLoop() {
+    while(true){
+        std::function<void()> job;
+        {
+            std::unique_lock lock{jobMutex};
+            jobAvailable.wait(lock, [this](){ return stopping || !jobs.empty(); });
+
+            if(jobs.empty()){
+                return;
+            }
+
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+
+        job();
+    }
+}